@@ -48,6 +48,9 @@ namespace NiS {
 		                                            const QString & fragment_shader_source_path ,
 		                                            QObject * parent = 0 );
 
+		// Restores the images of the keyframes released in streaming mode to build their point clouds
+		void SetFrameLoader ( const KeyFrameLoader & loader ) { frame_loader_ = loader; }
+
 	protected:
 
 		virtual void initializeGL ( ) override;
@@ -125,6 +128,7 @@ namespace NiS {
 
 		std::vector < KeyFrameGL > keyframes_gl_;
 		std::vector < KeyFrameGL > keyframes_gl_for_inliers_;
+		KeyFrameLoader             frame_loader_;
 
 		std::vector < CorrespondingPointsGL > corresponding_points_pair_gl_;
 		std::vector < CorrespondingPointsGL > inliers_pair_gl_;
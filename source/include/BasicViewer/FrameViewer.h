@@ -6,7 +6,13 @@
 #define NIS_FRAMEVIEWER_H
 
 #include <SLAM/CommonDefinitions.h>
+#include <Core/Serialize.h>
 #include <QWidget>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QMap>
+#include <Handler/FramePrefetcher.h>
+#include <memory>
 #include "../../../bin/lib/BasicViewer/ui_FrameViewer.h"
 
 namespace Ui {
@@ -38,22 +44,58 @@ namespace NiS {
 		void onAddFilesButtonPushed ( );
 		void onClearButtonPushed ( );
 		void onFileListCurrentItemChanged ( int );
-		void onDetectMarkerButtonPushed ( );
+		void onFrameLoaded ( );
 		void onTryDetection ( );
+		void onDetectionResultReady ( int );
+		void onDetectionFinished ( );
 
 	private:
 
+		// A frame of a file in the list, row for row
+		struct FrameSource
+		{
+			QString                                  file_name;
+			int                                      frame;
+			std::shared_ptr < const RawDataFileInfo > info;      // layout of a multi frame .dat file, probed once
+		};
+
+		// A frame ready to be shown, with the detected markers drawn
+		struct DisplayFrame
+		{
+			ColorImage color_image;
+			ColorImage depth_image_rgb;
+			bool       has_marker = false;
+		};
+
+		static DisplayFrame LoadDisplayFrame ( const FrameSource & source );
+		static bool HasMarker ( const FrameSource & source );
+		static RawDataFrame ReadFrame ( const FrameSource & source );
+
+		void AddFile ( const QFileInfo & file_info );
+		void UpdateFrameSources ( );
+		void ShowFrame ( const DisplayFrame & frame );
 		void UpdateDisplayImage ( );
 
 		Ui::FrameViewer ui_;
 
 		ColorImage color_image_;
 		ColorImage depth_image_rgb_;
-		DepthImage depth_image_;
 		bool       has_marker_;
 
 		QStringList file_list_;
 
+		QList < FrameSource > frame_sources_;
+
+		// Layouts of the multi frame .dat files of the list, by path
+		QMap < QString , std::shared_ptr < const RawDataFileInfo > > file_infos_;
+
+		// Decodes and detects the frames around the current one in the background
+		FramePrefetcher < DisplayFrame > prefetcher_;
+		QFutureWatcher < DisplayFrame >  frame_watcher_;
+		int                              loading_row_;
+
+		QFutureWatcher < bool > detection_watcher_;
+
 	};
 
 
@@ -18,9 +18,11 @@ namespace NiS {
 	{
 	public:
 
+		// The loader restores the images of a released keyframe (streaming mode) while its data is set up
 		KeyFrameGL ( QOpenGLFunctions_4_1_Core * GL ,
 		             const KeyFrame & keyframe ,
-		             const int & point_cloud_density_step = 5 );
+		             const int & point_cloud_density_step = 5 ,
+		             const KeyFrameLoader & loader = KeyFrameLoader ( ) );
 
 		~KeyFrameGL ( ) { /*ReleaseData ( );*/ }
 
@@ -43,6 +45,8 @@ namespace NiS {
 		int point_cloud_density_step_;
 
 		KeyFrame keyframe_;
+
+		KeyFrameLoader loader_;
 	};
 
 	using KeyFramesGL = std::vector < KeyFrameGL >;
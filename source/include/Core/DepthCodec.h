@@ -0,0 +1,34 @@
+#ifndef NIS_DEPTHCODEC_H
+#define NIS_DEPTHCODEC_H
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+namespace NiS {
+
+	/*
+	 * Lossless codec for 16 bit depth images.
+	 *
+	 * Every pixel is predicted from its left neighbour (the first pixel of a row from the one above),
+	 * the zigzag coded residuals are cut into blocks of 16 and each block is bit packed with the width of
+	 * its largest residual. Holes (depth 0) and flat surfaces end up as blocks of a few bits or nothing at all.
+	 *
+	 * Encoded image : int32 rows, int32 cols, uint32 payload size, payload
+	 * Payload       : per row, per block of 16 pixels : uint8 bit width b, 2 * b bytes of packed residuals
+	 */
+	const int kDepthCodecBlockSize  = 16;
+	const int kDepthCodecHeaderSize = sizeof ( std::int32_t ) * 2 + sizeof ( std::uint32_t );
+
+	std::vector < uchar > EncodeDepthImage ( const cv::Mat_ < ushort > & depth_image );
+
+	// Size of the encoded image starting at data, 0 if the header does not fit in size.
+	std::size_t GetEncodedDepthImageSize ( const uchar * data , std::size_t size );
+
+	// Returns false for a broken stream, or a header whose size the payload cannot hold (or too large).
+	bool DecodeDepthImage ( const uchar * data , std::size_t size , cv::Mat_ < ushort > & depth_image );
+
+}
+
+#endif //NIS_DEPTHCODEC_H
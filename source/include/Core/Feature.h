@@ -32,8 +32,14 @@ namespace NiS {
 
 		Feature ( );
 
+		// Extracted by FeatureExtractor, see FeatureExtractor for batches
 		Feature ( const cv::Mat_ < uchar > & image , Type type );
 
+		// Feature computed beforehand (e.g. read from a FeatureStore). storage keeps the memory of descriptors alive
+		// when they are not owned (mapped files), the descriptors are then read only.
+		Feature ( Type type , const KeyPoints & key_points , const Descriptors & descriptors ,
+		          const std::shared_ptr < void > & storage = std::shared_ptr < void > ( ) );
+
 		~Feature ( );
 
 		Type GetType ( ) const { return type_; }
@@ -48,20 +54,7 @@ namespace NiS {
 		KeyPoints   key_points_;        // キーポイント
 		Descriptors descriptors_;       // キーポイントディスクリプタ
 
-		template < class Detector , class Extractor >
-		void Detect ( const cv::Mat_ < uchar > & image , KeyPoints * key_points , Descriptors * descriptors ) {
-
-			if ( !image.empty ( ) ) {
-
-				// detecting keypoints
-				Detector detector;
-				detector.detect ( image , * key_points );
-
-				// computing descriptors
-				Extractor extractor;
-				extractor.compute ( image , * key_points , * descriptors );
-			}
-		}
+		std::shared_ptr < void > storage_;     // of descriptors_ when they refer to a mapping
 
 		friend class boost::serialization::access;
 
@@ -84,20 +77,12 @@ namespace NiS {
 			ar & key_points_;
 			ar & m;
 			descriptors_ = m;
+			storage_.reset ( );
 		}
 
 	};
 
-	// Forward delacration of member template functions.
-	// Need to be inplemented in .cpp file.
-	// Have a look at the .cpp file for detail implementation.
-
-	// This template impelemtation is just for reference
-	template < >
-	void Feature::Detect < cv::SiftFeatureDetector , cv::SiftDescriptorExtractor > ( const cv::Mat_ < uchar > & image ,
-	                                                                                 KeyPoints * key_points ,
-	                                                                                 Descriptors * descriptors );
-
+	// gzip compressed archive of a single feature, LoadFeature also reads the uncompressed ones of former versions
 	bool SaveFeature ( const std::string & name , const Feature & feature );
 	bool LoadFeature ( const std::string & name , Feature & feature );
 
@@ -0,0 +1,123 @@
+#ifndef NIS_FEATUREEXTRACTOR_H
+#define NIS_FEATUREEXTRACTOR_H
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+#include <QString>
+
+#include "Core/Feature.h"
+
+namespace NiS {
+
+	/*
+	 * Grid bucketed detection : the image is split in grid_cols x grid_rows cells, each cell keeps its max_per_cell
+	 * strongest key points (response), then the max_key_points strongest ranks of all the cells are kept (the best of
+	 * every cell, then the second best...). Key points spread over the frame and their count is bounded.
+	 * Disabled (all the detected key points) when one of them is 0, as by default.
+	 *
+	 * Depth prefilter, when the depth image is given : key points with a pixel without depth within
+	 * depth_filter_radius, or a depth step over max_depth_step (relative to their depth), have no usable 3D point
+	 * and are dropped before the bucketing and the descriptors. Disabled when depth_filter_radius is negative, as by
+	 * default : the features of the former versions (all the key points) stay valid.
+	 */
+	struct DetectionParameters
+	{
+		static const int kDepthFilterRadius = 1;     // of the enabled prefilter
+
+		int   grid_cols;
+		int   grid_rows;
+		int   max_per_cell;
+		int   max_key_points;
+		int   depth_filter_radius;
+		float max_depth_step;
+
+		DetectionParameters ( ) :
+				grid_cols ( 8 ) ,
+				grid_rows ( 6 ) ,
+				max_per_cell ( 0 ) ,
+				max_key_points ( 0 ) ,
+				depth_filter_radius ( -1 ) ,
+				max_depth_step ( 0.05f ) { }
+
+		DetectionParameters ( int grid_cols , int grid_rows , int max_per_cell , int max_key_points ) :
+				grid_cols ( grid_cols ) ,
+				grid_rows ( grid_rows ) ,
+				max_per_cell ( max_per_cell ) ,
+				max_key_points ( max_key_points ) ,
+				depth_filter_radius ( -1 ) ,
+				max_depth_step ( 0.05f ) { }
+
+		bool IsBucketed ( ) const { return grid_cols > 0 and grid_rows > 0 and max_per_cell > 0 and max_key_points > 0; }
+
+		bool IsDepthFiltered ( ) const { return depth_filter_radius >= 0; }
+
+		// Feature store parameters of the features detected with these parameters,
+		// kDefaultFeatureParameters when nothing is filtered
+		std::uint64_t Hash ( ) const;
+
+		bool operator== ( const DetectionParameters & parameters ) const { return Hash ( ) == parameters.Hash ( ); }
+
+		bool operator!= ( const DetectionParameters & parameters ) const { return !( * this == parameters ); }
+
+		QString Output ( ) const;
+
+		template < class Archive >
+		void serialize ( Archive & ar , const unsigned int version ) {
+
+			ar & grid_cols;
+			ar & grid_rows;
+			ar & max_per_cell;
+			ar & max_key_points;
+
+			// Version 0 had no depth prefilter
+			if ( version >= 1 ) {
+				ar & depth_filter_radius;
+				ar & max_depth_step;
+			} else {
+				depth_filter_radius = -1;
+			}
+		}
+	};
+
+	/*
+	 * Feature extraction of gray images with detectors and extractors that live as long as their thread. Each thread
+	 * (QtConcurrent or cv::parallel_for_ workers) configures them once per feature type and keeps its key point buffer,
+	 * so a run of extractions only allocates the results.
+	 *
+	 * Key points are detected then described like Feature ( image , type ) does, so that both give the same stored
+	 * features. FREAK describes the key points of SURF. When key points are filtered (bucketing, depth) only the kept
+	 * ones are described.
+	 */
+	class FeatureExtractor
+	{
+	public:
+
+		explicit FeatureExtractor ( Feature::Type type , const DetectionParameters & parameters = DetectionParameters ( ) );
+
+		Feature::Type GetType ( ) const { return type_; }
+
+		const DetectionParameters & GetDetectionParameters ( ) const { return parameters_; }
+
+		// Empty feature of the type for an empty image. The depth image, of the size of the gray image, is used by the
+		// depth prefilter, none skips it.
+		Feature Extract ( const cv::Mat_ < uchar > & gray_image ,
+		                  const cv::Mat_ < ushort > & depth_image = cv::Mat_ < ushort > ( ) ) const;
+
+		// Features of the images in the same order, extracted in parallel. depth_images is empty or one per image.
+		std::vector < Feature > Extract ( const std::vector < cv::Mat_ < uchar > > & gray_images ,
+		                                  const std::vector < cv::Mat_ < ushort > > & depth_images =
+		                                  std::vector < cv::Mat_ < ushort > > ( ) ) const;
+
+	private:
+
+		Feature::Type       type_;
+		DetectionParameters parameters_;
+	};
+
+}
+
+BOOST_CLASS_VERSION( NiS::DetectionParameters , 1 )
+
+#endif //NIS_FEATUREEXTRACTOR_H
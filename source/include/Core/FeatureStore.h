@@ -0,0 +1,142 @@
+#ifndef NIS_FEATURESTORE_H
+#define NIS_FEATURESTORE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "Core/Feature.h"
+
+namespace NiS {
+
+	/*
+	 * Feature store, holds the features of every frame of a dataset in one file.
+	 *
+	 *  FeatureStoreHeader
+	 *  payloads            per feature : zlib compressed key points, descriptors (kFeatureStoreAlignment aligned)
+	 *  FeatureStoreEntry[] index, one entry per feature (at header.index_offset)
+	 *
+	 * Features are keyed by frame name, feature type and detector parameters. Flush appends the new features and
+	 * a new index, the header is written last : an interrupted flush leaves the previous index valid. When features
+	 * already stored are replaced, or when the previous indexes left by the appends make a quarter of the file,
+	 * Flush writes a compacted copy instead, which replaces the store once complete.
+	 *
+	 * Loaded descriptors refer to the mapping (kept alive by the features), only the key points are decoded.
+	 */
+	const char          kFeatureStoreMagic[16] = "NIS FEATURES";
+	const int           kFeatureStoreVersion   = 1;
+	const std::uint64_t kFeatureStoreAlignment = 64;
+	const std::string   kFeatureStoreFileName  = "Features.store";
+
+	// Parameters of the detectors and extractors used by Feature ( image , type ), DetectionParameters::Hash of the
+	// detection keeping all the key points
+	const std::uint64_t kDefaultFeatureParameters = 0;
+
+	// Parameters of the features of images scaled down by scale, the same parameters for the recorded images
+	inline std::uint64_t ScaledFeatureParameters ( std::uint64_t parameters , int scale ) {
+
+		return scale == 1 ? parameters : parameters ^ ( static_cast < std::uint64_t > ( scale ) << 56 );
+	}
+
+	// Parameters of the features detected with depth images registered to the color frame (DepthRegistration::Hash),
+	// the same parameters without registration (0). The high byte is left to ScaledFeatureParameters.
+	inline std::uint64_t RegisteredFeatureParameters ( std::uint64_t parameters , std::uint64_t registration ) {
+
+		if ( registration == 0 ) {
+			return parameters;
+		}
+
+		const std::uint64_t mixed = ( ( parameters ^ registration ) * 1099511628211ull ) & 0x00FFFFFFFFFFFFFFull;
+
+		return mixed == kDefaultFeatureParameters ? 1 : mixed;
+	}
+
+	struct FeatureStoreHeader
+	{
+		char          magic[16];
+		std::int32_t  version;
+		std::int32_t  entry_count;
+		std::uint64_t index_offset;
+		std::uint64_t reserved;
+	};
+
+	struct FeatureStoreEntry
+	{
+		std::uint64_t parameters;
+		std::uint64_t key_points_offset;
+		std::uint64_t descriptors_offset;
+		std::uint32_t key_points_size;      // compressed size
+		std::int32_t  key_point_count;
+		std::int32_t  type;
+		std::int32_t  descriptor_rows;
+		std::int32_t  descriptor_cols;
+		std::int32_t  descriptor_type;
+		char          frame[128];
+	};
+
+	struct FeatureKey
+	{
+		std::string   frame;        // frame name without directory nor extension
+		Feature::Type type;
+		std::uint64_t parameters;
+
+		bool operator< ( const FeatureKey & key ) const {
+
+			return std::tie ( frame , type , parameters ) < std::tie ( key.frame , key.type , key.parameters );
+		}
+	};
+
+	class FeatureStore
+	{
+	public:
+
+		// Opens (or creates on the first Flush) a store file.
+		explicit FeatureStore ( const std::string & file_name );
+		~FeatureStore ( );
+
+		FeatureStore ( const FeatureStore & ) = delete;
+		FeatureStore & operator= ( const FeatureStore & ) = delete;
+
+		// The store of a dataset directory, shared in the process until FlushFeatureStores.
+		static std::shared_ptr < FeatureStore > Open ( const std::string & dir_path );
+
+		// Thread safe. The descriptors of loaded features are read only.
+		bool Load ( const FeatureKey & key , Feature & feature ) const;
+		bool Store ( const FeatureKey & key , const Feature & feature );
+
+		// Writes the stored features to the file.
+		bool Flush ( );
+
+		int GetFeatureCount ( ) const;
+
+	private:
+
+		struct Pending
+		{
+			FeatureStoreEntry                              entry;
+			std::shared_ptr < const std::vector < char > > key_points;     // compressed, shared with Load
+			cv::Mat                                        descriptors;
+		};
+
+		bool Map ( );
+
+		std::string                                           name_;
+		mutable std::mutex                                    mutex_;
+		std::shared_ptr < boost::iostreams::mapped_file_source > file_;
+		std::map < FeatureKey , FeatureStoreEntry >           index_;
+		std::map < FeatureKey , Pending >                     pending_;
+		std::uint64_t                                         stale_bytes_;     // of the mapped file, in no entry
+	};
+
+	// Flushes and closes the stores opened by FeatureStore::Open.
+	void FlushFeatureStores ( );
+
+}
+
+#endif //NIS_FEATURESTORE_H
@@ -0,0 +1,91 @@
+#ifndef NIS_FRAMEPOOL_H
+#define NIS_FRAMEPOOL_H
+
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+namespace NiS {
+
+	struct FramePoolStatistics
+	{
+		std::size_t hits;             // allocations served by a recycled buffer
+		std::size_t misses;           // allocations of a new buffer
+		std::size_t recycled;         // buffers returned to the pool
+		std::size_t dropped;          // buffers freed because the pool was full
+		std::size_t cached_buffers;   // buffers waiting in the pool
+		std::size_t cached_bytes;
+	};
+
+	/*
+	 * Allocator of the frame sized images (color, depth, point and gray images). The frames of a recording all have the
+	 * same size, so a released buffer is kept by its byte size and handed to the next image of that size instead of
+	 * going back to the heap. A cv::Mat uses it once its allocator is set (see CreatePooledImage), it is kept through
+	 * copies and assignments, and the last release returns the buffer.
+	 *
+	 * Buffers smaller than kMinPooledBytes (descriptors, small matrices) are allocated and freed as usual.
+	 */
+	class FramePool : public cv::MatAllocator
+	{
+	public:
+
+		static const std::size_t kMinPooledBytes       = 64 * 1024;
+		static const std::size_t kDefaultCapacityBytes = 256 * 1024 * 1024;
+
+		// Shared by the reader and the conversion stages. Never destroyed : images may outlive the static objects.
+		static FramePool & Instance ( );
+
+		explicit FramePool ( std::size_t capacity_bytes = kDefaultCapacityBytes );
+		~FramePool ( );
+
+		FramePool ( const FramePool & ) = delete;
+		FramePool & operator = ( const FramePool & ) = delete;
+
+		void allocate ( int dims , const int * sizes , int type , int *& refcount ,
+		                uchar *& datastart , uchar *& data , size_t * step ) override;
+		void deallocate ( int * refcount , uchar * datastart , uchar * data ) override;
+
+		// Bytes the pool may keep, the cached buffers over it are freed
+		void SetCapacity ( std::size_t capacity_bytes );
+		std::size_t GetCapacity ( ) const;
+
+		// Frees the cached buffers, the images in use are not affected
+		void Clear ( );
+
+		FramePoolStatistics GetStatistics ( ) const;
+		void ResetStatistics ( );
+
+	private:
+
+		void Trim ( );
+
+		mutable std::mutex mutex_;
+		std::unordered_map < std::size_t , std::vector < uchar * > > buffers_;     // by byte size
+		std::size_t         capacity_bytes_;
+		FramePoolStatistics statistics_;
+	};
+
+	// Unset image of the pool, create and the OpenCV functions writing into it draw the buffer from the pool
+	template < typename T >
+	inline cv::Mat_ < T > PooledImage ( ) {
+
+		cv::Mat_ < T > image;
+		image.allocator = & FramePool::Instance ( );
+		return image;
+	}
+
+	// Image of rows x cols from the pool, the values are not initialized
+	template < typename T >
+	inline cv::Mat_ < T > CreatePooledImage ( int rows , int cols ) {
+
+		cv::Mat_ < T > image = PooledImage < T > ( );
+		image.create ( rows , cols );
+		return image;
+	}
+
+}
+
+#endif //NIS_FRAMEPOOL_H
@@ -7,12 +7,14 @@
 
 #include <opencv2/opencv.hpp>
 
+#include "Core/FramePool.h"
+
 namespace NiS {
 	/// 画像のサイズ変更
 	template < typename T >
 	cv::Mat_ < T > Resize ( const cv::Mat_ < T > & image , int w , int h , int interpolation = cv::INTER_LINEAR ) {
 
-		cv::Mat_ < T > cvt_image;
+		cv::Mat_ < T > cvt_image = PooledImage < T > ( );
 
 		if ( !image.empty ( ) && w > 0 && h > 0 ) {
 			cv::resize ( image , cvt_image , cv::Size ( w , h ) , 0 , 0 , interpolation );
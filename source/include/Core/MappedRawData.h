@@ -0,0 +1,116 @@
+#ifndef NIS_MAPPEDRAWDATA_H
+#define NIS_MAPPEDRAWDATA_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Core/Serialize.h"
+
+#if !defined(__unix__) && !defined(__APPLE__)
+#include <boost/iostreams/device/mapped_file.hpp>
+#endif
+
+namespace NiS {
+
+	/**
+	 * Private (copy-on-write) mapping of a whole file. The file descriptor is closed as soon as the file is mapped,
+	 * so a directory of one frame files costs one mapping per file and no open file. Throws std::runtime_error when
+	 * the file can not be mapped.
+	 */
+	class FileMapping
+	{
+	public:
+
+		explicit FileMapping ( const std::string & file_name );
+		~FileMapping ( );
+
+		FileMapping ( const FileMapping & ) = delete;
+		FileMapping & operator = ( const FileMapping & ) = delete;
+
+		char * GetData ( ) const { return data_; }
+		std::size_t GetSize ( ) const { return size_; }
+
+	private:
+
+		char        * data_;
+		std::size_t size_;
+
+#if !defined(__unix__) && !defined(__APPLE__)
+		boost::iostreams::mapped_file file_;
+#endif
+	};
+
+	/**
+	 * Memory mapped view of a XTION .dat file.
+	 *
+	 * The file is mapped privately (copy-on-write), and the images of the returned frames point straight
+	 * into the mapped pages instead of being copied out of a stream. Compressed depth images
+	 * (kRawDataFrameDepthCodecFlag) are decoded from the mapping into images of their own. Drawing on such an image only touches
+	 * the process' private copy of that page, the file itself is never modified.
+	 * Every returned frame holds a reference to the mapping, so the frames stay valid after this object is gone.
+	 */
+	class MappedRawDataFile
+	{
+	public:
+
+		MappedRawDataFile ( );
+		explicit MappedRawDataFile ( const std::string & file_name );
+
+		bool IsOpen ( ) const { return static_cast < bool > ( file_ ); }
+		int GetVersion ( ) const { return version_; }
+		int GetFrameCount ( ) const { return static_cast < int > ( layouts_.size ( ) ); }
+		const std::string & GetName ( ) const { return name_; }
+
+		// Encoded depth is decoded now, or by RawDataFrame::GetDepthImage when decode_depth is false
+		RawDataFrame GetFrame ( int index , bool decode_depth = true ) const;
+		RawDataFrames GetFrames ( ) const;
+
+		// Pulls the pixel data of the frame into memory now instead of on first access.
+		void Prefetch ( int index ) const;
+
+	private:
+
+		struct MatLayout
+		{
+			int         rows;
+			int         cols;
+			int         type;
+			std::size_t offset;     // offset of the pixel data from the beginning of the file
+			std::size_t encoded;    // size of the DepthCodec stream at offset, 0 for raw pixels
+		};
+
+		struct FrameLayout
+		{
+			MatLayout color;
+			MatLayout depth;
+		};
+
+		bool Parse ( );
+		bool ParseMat ( std::size_t & offset , MatLayout & layout ) const;
+		bool ParseEncodedDepth ( std::size_t & offset , MatLayout & layout ) const;
+		// False when the encoded depth can not be decoded
+		bool CreateMat ( const MatLayout & layout , cv::Mat & mat ) const;
+
+		std::string                                      name_;
+		int                                              version_;
+		std::shared_ptr < FileMapping >                  file_;
+		std::vector < FrameLayout >                      layouts_;
+	};
+
+	// Bytes of a rows x cols image of type, false for negative dimensions or a size that does not fit in size_t
+	bool GetMatByteSize ( int rows , int cols , int type , std::size_t & byte_size );
+
+	// Pulls [begin, end) of a mapping into memory on the calling thread.
+	void PrefetchMappedRange ( const char * data , std::size_t begin , std::size_t end );
+
+	// Maps a single .dat file and returns all of its frames.
+	RawDataFrames MapRawDataFrames ( const std::string & file_name );
+
+	// Maps every .dat file of the directory (sorted by name), the first frame of each file is used.
+	// Frame ids are assigned in the order of the files.
+	RawDataFrames MapRawDataDirectory ( const std::string & dir_path );
+
+}
+
+#endif //NIS_MAPPEDRAWDATA_H
@@ -0,0 +1,124 @@
+#ifndef NIS_SEQUENCEFILE_H
+#define NIS_SEQUENCEFILE_H
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "Core/Serialize.h"
+
+namespace NiS {
+
+	/*
+	 * Packed sequence file (.seq), holds a whole sequence of XTION frames in one file.
+	 *
+	 *  SequenceFileHeader
+	 *  payloads             color and depth pixels of every frame, each starts on a kSequencePayloadAlignment boundary
+	 *  SequenceFrameEntry[] frame table, one fixed size entry per frame (at header.table_offset)
+	 *
+	 * Any frame is found in O(1) through the table, and the aligned payloads are used in place from the mapping.
+	 */
+	const char          kSequenceFileMagic[16]    = "NIS SEQUENCE";
+	const int           kSequenceFileVersion      = 1;
+	const std::uint64_t kSequencePayloadAlignment = 4096;
+	const std::string   kSequenceFileExtension    = ".seq";
+
+	// SequenceFrameEntry::flags
+	const std::int32_t kSequenceFrameDepthEncoded = 1 << 0;     // the depth payload is a DepthCodec stream
+
+	struct SequenceFileHeader
+	{
+		char          magic[16];
+		std::int32_t  version;
+		std::int32_t  frame_count;
+		std::uint64_t table_offset;
+		std::uint64_t reserved;
+	};
+
+	struct SequenceFrameEntry
+	{
+		std::uint64_t color_offset;
+		std::uint64_t depth_offset;
+		std::int32_t  id;
+		std::int32_t  flags;
+		std::int32_t  color_rows;
+		std::int32_t  color_cols;
+		std::int32_t  color_type;
+		std::int32_t  depth_rows;
+		std::int32_t  depth_cols;
+		std::int32_t  depth_type;
+		char          name[64];     // file name of the original frame (without directory, null terminated), may be empty
+	};
+
+	bool IsSequenceFile ( const std::string & file_name );
+
+	class SequenceFileReader
+	{
+	public:
+
+		SequenceFileReader ( );
+		explicit SequenceFileReader ( const std::string & file_name );
+
+		bool IsOpen ( ) const { return static_cast < bool > ( file_ ); }
+		int GetFrameCount ( ) const { return frame_count_; }
+		const std::string & GetName ( ) const { return name_; }
+
+		// Frame images refer to the (private) mapping, which is kept alive by the returned frames.
+		// The frame name is the original frame name in the directory of the sequence file,
+		// or "<sequence path without extension>_<index>" when there is none.
+		// Encoded depth is decoded now, or by RawDataFrame::GetDepthImage when decode_depth is false
+		RawDataFrame GetFrame ( int index , bool decode_depth = true ) const;
+		std::string GetFrameName ( int index ) const;
+		void Prefetch ( int index ) const;
+
+	private:
+
+		const SequenceFrameEntry & GetEntry ( int index ) const;
+		// Bytes of the payloads of the entry, false when they are not within the file
+		bool GetPayloadSizes ( const SequenceFrameEntry & entry , std::size_t & color_size , std::size_t & depth_size ) const;
+
+		std::string                                      name_;
+		int                                              frame_count_;
+		const SequenceFrameEntry                         * table_;
+		std::shared_ptr < boost::iostreams::mapped_file > file_;
+	};
+
+	class SequenceFileWriter
+	{
+	public:
+
+		explicit SequenceFileWriter ( const std::string & file_name , bool encode_depth = false );
+		~SequenceFileWriter ( );
+
+		bool IsOpen ( ) const { return static_cast < bool > ( out_ ); }
+
+		// Frames are numbered in the order they are appended. Frames whose file name does not fit in
+		// SequenceFrameEntry::name are refused.
+		bool Append ( const RawDataFrame & frame );
+		// Writes the frame table and the final header.
+		bool Close ( );
+
+	private:
+
+		void Pad ( );
+
+		std::ofstream                     out_;
+		std::vector < SequenceFrameEntry > table_;
+		bool                              encode_depth_;
+		bool                              closed_;
+	};
+
+	// Packs the first frame of every .dat file of the directory (sorted by name) into one sequence file.
+	int ImportRawDataDirectory ( const std::string & dir_path , const std::string & sequence_file_name , bool encode_depth = false );
+	// Writes every frame of the sequence file back to a .dat file of its own.
+	int ExportRawDataDirectory ( const std::string & sequence_file_name , const std::string & dir_path , bool encode_depth = false );
+	// Rewrites the .dat files of a directory into another one, with the depth images encoded by the DepthCodec.
+	int EncodeRawDataDirectory ( const std::string & dir_path , const std::string & output_dir_path );
+
+}
+
+#endif //NIS_SEQUENCEFILE_H
@@ -6,7 +6,12 @@
 #define LK_SLAM_SERIALIZE_H
 
 #include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
 #include <string>
 #include <glm/glm.hpp>
 #include <boost/archive/binary_iarchive.hpp>
@@ -19,6 +24,9 @@
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include "Core/DepthCodec.h"
+#include "Core/FramePool.h"
+
 BOOST_SERIALIZATION_SPLIT_FREE( cv::Mat )
 
 namespace boost {
@@ -158,6 +166,36 @@ namespace NiS {
 		DepthImage  depth_image;
 		std::string name;
 		int         id;
+
+		// Keeps the backing storage (e.g. a memory mapped file) alive
+		// while the images refer to it. Empty for frames that own their images.
+		std::shared_ptr < void > storage;
+
+		// Frames read with their depth left encoded (streaming mode) : depth_image is empty, decode_depth decodes it
+		// from the mapped file each time it is needed.
+		std::function < bool ( DepthImage & ) > decode_depth;
+		cv::Size                                encoded_depth_size;
+
+		bool HasDepth ( ) const { return !depth_image.empty ( ) or static_cast < bool > ( decode_depth ); }
+
+		cv::Size GetDepthSize ( ) const { return decode_depth ? encoded_depth_size : depth_image.size ( ); }
+
+		// depth_image, or the decoded one. Empty when it does not decode.
+		DepthImage GetDepthImage ( ) const {
+
+			if ( !decode_depth ) {
+				return depth_image;
+			}
+
+			DepthImage decoded;
+
+			if ( !decode_depth ( decoded ) ) {
+				std::cout << "Corrupt depth of frame " << id << " in : " << name << std::endl;
+				decoded.release ( );
+			}
+
+			return decoded;
+		}
 	};
 
 
@@ -165,28 +203,28 @@ namespace NiS {
 
 
 // Parameters for reading AIST image data
-	const std::string kRawDataFrameHeader = "XTION DATA";
+	const std::string kRawDataFrameHeader  = "XTION DATA";
+	const int         kRawDataFrameVersion = 1;
 
-	const int kImageRows          = 480;
-	const int kImageCols          = 640;
+	// Format flag in the version of a .dat file : the depth images are stored with the DepthCodec
+	const int kRawDataFrameDepthCodecFlag = 1 << 16;
+
+	// The frame size is not fixed, it is read with the images (their rows and cols)
 	const int kColorImageChannels = 3;
 	const int kDepthImageChannels = 1;
 
-	const int kColorImageByteSize = kImageCols * kImageRows * kColorImageChannels * sizeof ( char );
-	const int kDepthImageByteSize = kImageCols * kImageRows * kDepthImageChannels * sizeof ( ushort );
-
 	const int kSkipLengthOfColorImage =
 			          sizeof ( char[10] ) +                    // sensor type
 			          sizeof ( int ) +                            // version
 			          sizeof ( int ) +                            // device count
-			          sizeof ( kImageRows ) +                    // color image rows
-			          sizeof ( kImageCols ) +                    // color image cols
+			          sizeof ( int ) +                            // color image rows
+			          sizeof ( int ) +                            // color image cols
 			          sizeof ( int );                            // color image type (OpenCV)
 
 
 	const int kSkipLengthOfDepthImage =
-			          sizeof ( kImageRows ) +                    // depth image rows
-			          sizeof ( kImageCols ) +                    // depth image cols
+			          sizeof ( int ) +                            // depth image rows
+			          sizeof ( int ) +                            // depth image cols
 			          sizeof ( int );                            // depth image type (OpenCV)
 
 
@@ -243,6 +281,7 @@ namespace NiS {
 		const int cols = Read < int > ( in );
 		const int type = Read < int > ( in );
 		cv::Mat   m;
+		m.allocator = & FramePool::Instance ( );
 		if ( rows * cols > 0 ) {
 			m.create ( rows , cols , type );
 			in.read ( reinterpret_cast< char * >( m.data ) , m.elemSize ( ) * rows * cols );
@@ -256,12 +295,39 @@ namespace NiS {
 		return T ( );
 	}
 
+	// Read a DepthCodec encoded depth image from stream
+	inline cv::Mat_ < ushort > ReadEncodedDepthImage ( std::istream & in ) {
+
+		std::vector < uchar > encoded ( kDepthCodecHeaderSize );
+		in.read ( reinterpret_cast< char * >( encoded.data ( )) , kDepthCodecHeaderSize );
+
+		cv::Mat_ < ushort > depth_image;
+
+		const std::size_t size = GetEncodedDepthImageSize ( encoded.data ( ) , static_cast< std::size_t >( in.gcount ( )) );
+		if ( size > 0 ) {
+			encoded.resize ( size );
+			in.read ( reinterpret_cast< char * >( encoded.data ( ) + kDepthCodecHeaderSize ) , size - kDepthCodecHeaderSize );
+
+			// A corrupt block fails the stream as a truncated one does, not a half decoded image
+			if ( !in or !DecodeDepthImage ( encoded.data ( ) , encoded.size ( ) , depth_image ) ) {
+				depth_image.release ( );
+				in.setstate ( std::ios::failbit );
+			}
+		}
+
+		return depth_image;
+	}
+
 	template < >
 	inline RawDataFrame Read ( std::istream & in , int version ) {
 
 		RawDataFrame frame;
 		frame.color_image = Read < cv::Mat > ( in );
-		frame.depth_image = Read < cv::Mat > ( in );
+		if ( version & kRawDataFrameDepthCodecFlag ) {
+			frame.depth_image = ReadEncodedDepthImage ( in );
+		} else {
+			frame.depth_image = Read < cv::Mat > ( in );
+		}
 		return frame;
 	}
 
@@ -289,6 +355,156 @@ namespace NiS {
 		return frames;
 	}
 
+	//----------------------------------------------
+	// Random access to the frames of a stream
+
+	struct RawDataMatInfo
+	{
+		int            rows;
+		int            cols;
+		int            type;
+		std::streamoff offset;      // position of the Mat (its header included) in the stream
+	};
+
+	struct RawDataFrameInfo
+	{
+		RawDataMatInfo color;
+		RawDataMatInfo depth;
+	};
+
+	struct RawDataFileInfo
+	{
+		int                             version = 0;
+		int                             count   = 0;     // frame count written in the header
+		std::vector < RawDataFrameInfo > frames;          // frames found by the probe
+		std::streamoff                  next    = 0;     // position of the first frame not probed, -1 after a broken one
+	};
+
+	// Skip a Mat (or an encoded depth image) of the stream, only its header is read
+	inline bool SkipMat ( std::istream & in , RawDataMatInfo & info , bool encoded ) {
+
+		info.offset = in.tellg ( );
+
+		if ( encoded ) {
+
+			uchar header[kDepthCodecHeaderSize];
+			in.read ( reinterpret_cast< char * >( header ) , kDepthCodecHeaderSize );
+
+			const std::size_t size = GetEncodedDepthImageSize ( header , static_cast< std::size_t >( in.gcount ( )) );
+			if ( size == 0 ) {
+				return false;
+			}
+
+			std::memcpy ( & info.rows , header , sizeof ( int ) );
+			std::memcpy ( & info.cols , header + sizeof ( int ) , sizeof ( int ) );
+			info.type = CV_16UC1;
+
+			in.seekg ( static_cast< std::streamoff >( size - kDepthCodecHeaderSize ) , std::ios::cur );
+
+		} else {
+
+			info.rows = Read < int > ( in );
+			info.cols = Read < int > ( in );
+			info.type = Read < int > ( in );
+
+			if ( in and info.rows * info.cols > 0 ) {
+				in.seekg ( static_cast< std::streamoff >( CV_ELEM_SIZE ( info.type ) * info.rows * info.cols ) , std::ios::cur );
+			}
+		}
+
+		return static_cast< bool >( in );
+	}
+
+	// Continue the probe of info until it has frame_count frames (or the stream has no more)
+	inline void ProbeMoreRawDataFrames ( std::istream & in , RawDataFileInfo & info , int frame_count ) {
+
+		if ( info.next <= 0 ) {
+			return;
+		}
+
+		const int  probe_count = std::min ( info.count , frame_count );
+		const bool encoded     = ( info.version & kRawDataFrameDepthCodecFlag ) != 0;
+
+		in.clear ( );
+		in.seekg ( info.next );
+
+		while ( static_cast< int >( info.frames.size ( )) < probe_count ) {
+
+			RawDataFrameInfo frame;
+
+			if ( !SkipMat ( in , frame.color , false ) or !SkipMat ( in , frame.depth , encoded ) ) {
+				info.next = -1;
+				break;
+			}
+
+			info.frames.push_back ( frame );
+			info.next = in.tellg ( );
+		}
+
+		in.clear ( );
+	}
+
+	// Probe the header and the frame layout of a stream without reading any pixel.
+	// max_frames limits the number of frames probed (-1 : all of them).
+	inline bool ProbeRawDataFrames ( std::istream & in , RawDataFileInfo & info , int max_frames = -1 ) {
+
+		info = RawDataFileInfo ( );
+
+		const std::string head = ReadString ( in , static_cast<unsigned int>( kRawDataFrameHeader.size ( )) );
+
+		if ( !in or head != kRawDataFrameHeader ) {
+			return false;
+		}
+
+		info.version = Read < int > ( in );
+		info.count   = Read < int > ( in );
+		info.next    = in.tellg ( );
+
+		ProbeMoreRawDataFrames ( in , info , max_frames < 0 ? info.count : max_frames );
+
+		return true;
+	}
+
+	// Read one frame of a probed stream
+	inline RawDataFrame ReadFrameAt ( std::istream & in , const RawDataFileInfo & info , int index ) {
+
+		RawDataFrame frame;
+		frame.id = index;
+
+		if ( 0 <= index and index < static_cast< int >( info.frames.size ( )) ) {
+
+			in.clear ( );
+			in.seekg ( info.frames[ index ].color.offset );
+			frame    = Read < RawDataFrame > ( in , info.version );
+			frame.id = index;
+		}
+
+		return frame;
+	}
+
+	// Read one frame of a stream, info keeps its layout between the calls (empty at first) : each frame header is
+	// read once, up to the highest index asked for, and the frames already probed are seeked to directly.
+	inline RawDataFrame ReadFrameAt ( std::istream & in , int index , RawDataFileInfo & info ) {
+
+		if ( index >= static_cast< int >( info.frames.size ( )) ) {
+
+			if ( info.next == 0 ) {
+
+				in.clear ( );
+				in.seekg ( 0 );
+
+				if ( !ProbeRawDataFrames ( in , info , index + 1 ) ) {
+					info = RawDataFileInfo ( );
+				}
+
+			} else {
+				ProbeMoreRawDataFrames ( in , info , index + 1 );
+			}
+		}
+
+		return ReadFrameAt ( in , info , index );
+	}
+
 	//----------------------------------------------
 	// Write Image Data
 
@@ -328,6 +544,24 @@ namespace NiS {
 			out.write ( reinterpret_cast< const char * >( vec.data ( )) , sizeof ( T ) * vec.size ( ) );
 		}
 	}
+
+	// Write multiple frames to stream, in the same layout as Read < RawDataFrames >
+	inline void WriteRawDataFrames ( std::ostream & out , const RawDataFrames & frames , int version = kRawDataFrameVersion ) {
+
+		out.write ( kRawDataFrameHeader.data ( ) , kRawDataFrameHeader.size ( ) );
+		Write < int > ( out , version );
+		Write < int > ( out , static_cast< int >( frames.size ( )) );
+
+		for ( const RawDataFrame & frame : frames ) {
+			Write < const cv::Mat & > ( out , frame.color_image );
+			if ( version & kRawDataFrameDepthCodecFlag ) {
+				const std::vector < uchar > encoded = EncodeDepthImage ( frame.depth_image );
+				out.write ( reinterpret_cast< const char * >( encoded.data ( )) , encoded.size ( ) );
+			} else {
+				Write < const cv::Mat & > ( out , frame.depth_image );
+			}
+		}
+	}
 }
 
 #endif //LK_SLAM_SERIALIZE_H
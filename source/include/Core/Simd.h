@@ -0,0 +1,44 @@
+#ifndef NIS_SIMD_H
+#define NIS_SIMD_H
+
+// Small SSE helpers shared by the image kernels, the callers keep a scalar path for the other targets.
+
+#if defined(__SSE2__)
+
+#include <emmintrin.h>
+
+namespace NiS {
+
+	// 4 depth values to float
+	inline __m128 LoadDepth4 ( const unsigned short * depth ) {
+
+		const __m128i v = _mm_loadl_epi64 ( reinterpret_cast < const __m128i * > ( depth ) );
+		return _mm_cvtepi32_ps ( _mm_unpacklo_epi16 ( v , _mm_setzero_si128 ( ) ) );
+	}
+
+	inline __m128 Negate4 ( __m128 v ) {
+
+		return _mm_xor_ps ( v , _mm_set1_ps ( -0.0f ) );
+	}
+
+	// Writes 4 points as x, y, z triplets (cv::Vec3f layout), 12 floats from out.
+	inline void StorePoints4 ( float * out , __m128 x , __m128 y , __m128 z ) {
+
+		const __m128 xy_low  = _mm_unpacklo_ps ( x , y );                                        // x0 y0 x1 y1
+		const __m128 xy_high = _mm_unpackhi_ps ( x , y );                                        // x2 y2 x3 y3
+
+		const __m128 z0_x1 = _mm_shuffle_ps ( z , x , _MM_SHUFFLE ( 1 , 1 , 0 , 0 ) );          // z0 z0 x1 x1
+		const __m128 y1_z1 = _mm_shuffle_ps ( y , z , _MM_SHUFFLE ( 1 , 1 , 1 , 1 ) );          // y1 y1 z1 z1
+		const __m128 z2_x3 = _mm_shuffle_ps ( z , xy_high , _MM_SHUFFLE ( 2 , 2 , 2 , 2 ) );    // z2 z2 x3 x3
+		const __m128 y3_z3 = _mm_shuffle_ps ( xy_high , z , _MM_SHUFFLE ( 3 , 3 , 3 , 3 ) );    // y3 y3 z3 z3
+
+		_mm_storeu_ps ( out + 0 , _mm_shuffle_ps ( xy_low , z0_x1 , _MM_SHUFFLE ( 2 , 0 , 1 , 0 ) ) );   // x0 y0 z0 x1
+		_mm_storeu_ps ( out + 4 , _mm_shuffle_ps ( y1_z1 , xy_high , _MM_SHUFFLE ( 1 , 0 , 2 , 0 ) ) );  // y1 z1 x2 y2
+		_mm_storeu_ps ( out + 8 , _mm_shuffle_ps ( z2_x3 , y3_z3 , _MM_SHUFFLE ( 2 , 0 , 2 , 0 ) ) );    // z2 x3 y3 z3
+	}
+
+}
+
+#endif
+
+#endif //NIS_SIMD_H
@@ -6,6 +6,7 @@
 #define LK_SLAM_UTILITY_H
 
 #include <algorithm>
+#include <functional>
 #include <string>
 #include <opencv2/opencv.hpp>
 
@@ -74,6 +75,20 @@ namespace NiS {
 		return os;
 	}
 
+	// cv::parallel_for_ body calling a function (a lambda) with each range
+	class ParallelRange : public cv::ParallelLoopBody
+	{
+	public:
+
+		explicit ParallelRange ( std::function < void ( const cv::Range & ) > body ) : body_ ( std::move ( body ) ) { }
+
+		void operator () ( const cv::Range & range ) const override { body_ ( range ); }
+
+	private:
+
+		std::function < void ( const cv::Range & ) > body_;
+	};
+
 	inline QString ConvertTime ( int ms ) {
 
 		int s = ms / 1000;
@@ -0,0 +1,132 @@
+#ifndef NIS_FRAMEPREFETCHER_H
+#define NIS_FRAMEPREFETCHER_H
+
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <map>
+#include <utility>
+
+#include <QFuture>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+namespace NiS {
+
+	/*
+	 * Loads frames by index on a thread pool of its own and keeps the most recently used ones.
+	 *
+	 * Only the owning (GUI) thread calls the member functions, the loader runs on the pool and must not
+	 * touch anything that thread may change; capture copies of what it needs.
+	 * Evicted frames that are still loading finish in the background and are dropped. Clear also drops
+	 * the loads that have not started yet, whose futures never finish : watch futures, never wait on them.
+	 */
+	template < typename Frame >
+	class FramePrefetcher
+	{
+	public:
+
+		using Loader = std::function < Frame ( int ) >;
+
+		explicit FramePrefetcher ( int capacity = 32 , int thread_count = 2 ) :
+				capacity_ ( std::max ( capacity , 1 ) ) {
+
+			pool_.setMaxThreadCount ( std::max ( thread_count , 1 ) );
+		}
+
+		~FramePrefetcher ( ) { pool_.waitForDone ( ); }
+
+		FramePrefetcher ( const FramePrefetcher & ) = delete;
+		FramePrefetcher & operator= ( const FramePrefetcher & ) = delete;
+
+		// Drops every frame, the next requests go through the new loader.
+		void SetLoader ( const Loader & loader ) {
+
+			Clear ( );
+			loader_ = loader;
+		}
+
+		void Clear ( ) {
+
+			pool_.clear ( );
+			frames_.clear ( );
+			recent_.clear ( );
+		}
+
+		// Returns the (possibly still running) load of the frame, starting it when it is not cached.
+		QFuture < Frame > Request ( int index ) {
+
+			auto itr = frames_.find ( index );
+
+			if ( itr != frames_.end ( ) ) {
+				recent_.splice ( recent_.begin ( ) , recent_ , itr->second.second );
+				return itr->second.first;
+			}
+
+			QFuture < Frame > future = loader_ ? QtConcurrent::run ( & pool_ , loader_ , index ) : QFuture < Frame > ( );
+
+			recent_.push_front ( index );
+			frames_.insert ( std::make_pair ( index , std::make_pair ( future , recent_.begin ( ) ) ) );
+
+			Evict ( );
+
+			return future;
+		}
+
+		// Starts loading the frames around index (nearest first), within [0, count).
+		// The frames in [index - radius, index + radius] must fit in the capacity to stay cached.
+		void Prefetch ( int index , int radius , int count ) {
+
+			radius = std::min ( radius , ( capacity_ - 1 ) / 2 );
+
+			for ( auto distance = 1 ; distance <= radius ; ++distance ) {
+				if ( index + distance < count ) {
+					Touch ( index + distance );
+				}
+				if ( index - distance >= 0 ) {
+					Touch ( index - distance );
+				}
+			}
+
+			// Keep the requested frame the most recent one
+			if ( frames_.count ( index ) ) {
+				Request ( index );
+			}
+		}
+
+		bool IsReady ( int index ) const {
+
+			auto itr = frames_.find ( index );
+			return itr != frames_.end ( ) and itr->second.first.isFinished ( );
+		}
+
+	private:
+
+		// Starts the load without moving an already cached frame to the front.
+		void Touch ( int index ) {
+
+			if ( !frames_.count ( index ) ) {
+				Request ( index );
+			}
+		}
+
+		void Evict ( ) {
+
+			while ( static_cast < int > ( frames_.size ( ) ) > capacity_ ) {
+				frames_.erase ( recent_.back ( ) );
+				recent_.pop_back ( );
+			}
+		}
+
+		using Entry = std::pair < QFuture < Frame > , std::list < int >::iterator >;
+
+		int                    capacity_;
+		Loader                 loader_;
+		std::map < int , Entry > frames_;
+		std::list < int >      recent_;     // most recently used first
+		QThreadPool            pool_;
+	};
+
+}
+
+#endif //NIS_FRAMEPREFETCHER_H
@@ -16,6 +16,8 @@
 #include <SLAM/KeyFrame.h>
 #include <SLAM/Calibrator.h>
 #include <SLAM/CoordinateConverter.h>
+#include <SLAM/DepthRegistration.h>
+#include <SLAM/PointImageCache.h>
 
 #include <QFutureWatcher>
 
@@ -28,28 +30,66 @@ namespace NiS {
 
 	public:
 
-		struct XtionFrameProperty
-		{
-			static const float kXtionHorizontalFOV;
-			static const float kXtionVerticalFOV;
-			static const float kXtionWidth;
-			static const float kXtionHeight;
-		};
-
 		inline ImageHandler2 ( QFileInfoList file_list , QObject * parent = 0 ) :
+				calibrated_ ( false ) ,
 				file_list_ ( file_list ) ,
-				xz_factor_ ( GetXtionDepthFactor ( XtionFrameProperty::kXtionHorizontalFOV ) ) ,
-				yz_factor_ ( GetXtionDepthFactor ( XtionFrameProperty::kXtionVerticalFOV ) ) { }
+				streaming_ ( false ) ,
+				compact_point_images_ ( false ) ,
+				registration_ ( std::make_shared < DepthRegistration > ( ) ) ,
+				converted_registration_ ( registration_ ) ,
+				processing_scale_ ( ProcessingScale::Full ) ,
+				frame_size_ ( static_cast < int > ( CoordinateConverter::XtionFrameProperty::kXtionWidth ) ,
+				              static_cast < int > ( CoordinateConverter::XtionFrameProperty::kXtionHeight ) ) { }
 
 		inline ~ImageHandler2 ( ) { }
 
-		inline void SetInternalCalibrator ( Calibrator const & calibrator ) { calibrator_ = calibrator; }
+		inline void SetInternalCalibrator ( Calibrator const & calibrator ) {
+
+			calibrator_ = calibrator;
+			calibrator_.SetFrameSize ( frame_size_ );
+		}
 
 		inline RawDataFrames GetRawDataFrames ( ) const { return raw_data_frames_; }
 
 		inline const KeyFrames & GetKeyFrames ( ) const { return keyframes_; }
 
-		static NiS::RawDataFrame ReadFrame ( const QString & file_name );
+		// index is the frame number inside the file (.dat or .seq)
+		static NiS::RawDataFrame ReadFrame ( const QString & file_name , int index = 0 );
+		// Frame of a .dat file probed beforehand (ProbeRawDataFrames), read without going through the headers again
+		static NiS::RawDataFrame ReadFrame ( const QString & file_name , const RawDataFileInfo & info , int index );
+
+		// Streaming mode : the converted keyframes only keep their features and key point points, the images are
+		// restored by LoadKeyFrame when the answers or the viewers need them (safe from several threads). Encoded
+		// depth stays encoded in the mapped files, it is decoded again on each restore (set before reading).
+		inline void SetStreamingMode ( bool streaming ) { streaming_ = streaming; }
+		inline bool IsStreamingMode ( ) const { return streaming_; }
+
+		void LoadKeyFrame ( KeyFrame & keyframe ) const;
+
+		// Cached point images are kept as PointImages (default) or as CompactPointImages (int16 millimetres)
+		inline void SetCompactPointImages ( bool compact ) { compact_point_images_ = compact; }
+
+		// Depth images are warped into the color frame before use, for recordings where they are not aligned. The Xtion
+		// converter takes the fovs of the color camera. The calibrated conversions do not use it, their per pixel
+		// tables are of the depth camera.
+		inline void SetDepthRegistration ( const DepthRegistration & registration ) {
+
+			registration_    = std::make_shared < DepthRegistration > ( registration );
+			xtion_converter_ = XtionCoordinateConverter ( registration.GetColorHorizontalFOV ( ) ,
+			                                              registration.GetColorVerticalFOV ( ) );
+			xtion_converter_.SetFrameSize ( frame_size_ );
+		}
+
+		// Color and depth images are scaled down before use (set before reading)
+		inline void SetProcessingScale ( ProcessingScale scale ) { processing_scale_ = scale; }
+		inline ProcessingScale GetProcessingScale ( ) const { return processing_scale_; }
+
+		// Key point detection of the features extracted by the conversion (set before converting)
+		inline void SetDetectionParameters ( const DetectionParameters & parameters ) { detection_parameters_ = parameters; }
+		inline const DetectionParameters & GetDetectionParameters ( ) const { return detection_parameters_; }
+
+		// Size of the processed frames, known once the frames are read. The converters are set to it.
+		inline cv::Size GetFrameSize ( ) const { return frame_size_; }
 
 	signals:
 
@@ -72,6 +112,7 @@ namespace NiS {
 
 			aist_converter_    = converter;
 			converter_pointer_ = & aist_converter_;
+			aist_converter_.SetFrameSize ( frame_size_ );
 		}
 
 		XtionCoordinateConverter GetXtionCoordinateConverter ( ) const { return xtion_converter_; }
@@ -79,47 +120,48 @@ namespace NiS {
 
 	private:
 
+		// Builds keyframes_ from raw_data_frames_ with point_images_ and the depth images registered by registration,
+		// the features are extracted in parallel. label is appended to the progress messages.
+		void ConvertFrames ( const QString & label , std::shared_ptr < const DepthRegistration > registration );
+
 		void ConvertHelper ( );
 
 		void ConvertHelper ( bool calibrated );
 
-		float GetXtionDepthFactor ( float fov ) {
+		// Images of a keyframe from a raw frame : depth registered to the color frame, both scaled down
+		void PrepareImages ( const RawDataFrame & frame , ColorImage & color_image , DepthImage & depth_image ) const;
 
-			return tanf ( fov / 2 ) * 2;
-		}
-
-		inline cv::Point3f ScreenToWorld ( int x , int y , float depth ) {
+		// frame_size_ from the first read frame, given to the converters and the calibrator. The frames of another size
+		// are dropped from raw_data_frames_ (reported).
+		void UpdateFrameSize ( );
 
-			const float gz = 0.001f * depth;
-			cv::Point3f p;
-			p.x = gz * xz_factor_ * ( static_cast<float>(x) / XtionFrameProperty::kXtionWidth - 0.5f );
-			p.y = -gz * yz_factor_ * ( static_cast<float>(y) / XtionFrameProperty::kXtionHeight - 0.5f );
-			p.z = -gz;
-
-			return p;
-		}
-
-		inline cv::Point2f WorldToScreen ( const cv::Point3f & point ) {
-
-			const float x = ( point.x / ( point.z * xz_factor_ ) + 0.5f ) * XtionFrameProperty::kXtionWidth;
-			const float y = ( point.y / ( point.z * yz_factor_ ) + 0.5f ) * XtionFrameProperty::kXtionHeight;
-			return cv::Point2f ( x , y );
-		}
-
-		PointImage ConvertDepthImageToPointImage ( DepthImage const & depth_image , int choice );
+		// Identity registration for the calibrated conversions (label), which work on the depth camera images
+		std::shared_ptr < const DepthRegistration > GetCalibratedRegistration ( const QString & label );
 
 		bool          calibrated_;
 		Calibrator    calibrator_;
 		QFileInfoList file_list_;
 		RawDataFrames raw_data_frames_;
 		KeyFrames     keyframes_;
+		bool          streaming_;
+		bool          compact_point_images_;
+
+		// Point images of the current keyframes
+		std::shared_ptr < PointImageCache > point_images_;
+
+		// Identity unless set
+		std::shared_ptr < const DepthRegistration > registration_;
+
+		// Of the depth images of keyframes_, restored by LoadKeyFrame
+		std::shared_ptr < const DepthRegistration > converted_registration_;
+
+		ProcessingScale     processing_scale_;
+		cv::Size            frame_size_;
+		DetectionParameters detection_parameters_;
 
 		CoordinateConverter * converter_pointer_;
 		XtionCoordinateConverter xtion_converter_;
 		AistCoordinateConverter  aist_converter_;
-
-		float xz_factor_;
-		float yz_factor_;
 	};
 
 
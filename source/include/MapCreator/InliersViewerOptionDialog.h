@@ -47,10 +47,21 @@ namespace NiS {
 		InliersViewerOptionDialog ( QWidget * parent = 0 );
 		~InliersViewerOptionDialog ( );
 
+		// Restores the images of the frames released in streaming mode when they are chosen
+		void SetFrameLoader ( const KeyFrameLoader & loader ) { frame_loader_ = loader; }
+
 	private:
 
-		void SetFrame1 ( const KeyFrame & frame1 ) { keyframes_for_inliers_[ 0 ] = frame1; };
-		void SetFrame2 ( const KeyFrame & frame2 ) { keyframes_for_inliers_[ 1 ] = frame2; };
+		void SetFrame1 ( const KeyFrame & frame1 ) { SetFrame ( 0 , frame1 ); };
+		void SetFrame2 ( const KeyFrame & frame2 ) { SetFrame ( 1 , frame2 ); };
+		void SetFrame ( int position , const KeyFrame & frame ) {
+
+			keyframes_for_inliers_[ position ] = frame;
+
+			if ( !frame.HasImages ( ) and frame_loader_ ) {
+				frame_loader_ ( keyframes_for_inliers_[ position ] );
+			}
+		}
 		void ComputeCorrespondingPoints ( );
 
 		Ui::InliersViewerOptionDialog ui_;
@@ -59,6 +70,8 @@ namespace NiS {
 
 		KeyFrames keyframes_for_inliers_;
 
+		KeyFrameLoader frame_loader_;
+
 		Options options_;
 
 		bool has_frame1_;
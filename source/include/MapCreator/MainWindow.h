@@ -51,6 +51,7 @@ namespace NiS {
 		void onActionStartSlamComputation ( );
 		void onActionOpenDataFiles ( );
 		void onActionOpenInternalCalibrationFile ( );
+		void onActionOpenDepthRegistrationFile ( );
 		void onActionInternalCalibration ( );
 		void onActionOpenInliersViewerMode ( bool );
 		void onActionCaptureModelImage ( );
@@ -86,12 +87,16 @@ namespace NiS {
 		void WriteResult ( const std::pair < glm::vec3 , glm::vec3 > & marker_points_pair );
 		void ResetWatcher ( );
 
+		// Scale checked in Edit > Processing Scale
+		ProcessingScale GetProcessingScale ( ) const;
+
 		bool computation_configured_;
 		bool computation_done_;
 
 		TrackingType type_;
 
-		KeyFrames keyframes_;
+		KeyFrames      keyframes_;
+		KeyFrameLoader frame_loader_;     // restores the images of the frames released in streaming mode
 
 		ImageHandler2 * handler_;
 		SlamComputer  * computer_;
@@ -7,12 +7,15 @@
 
 
 #include <QDialog>
+#include <QFutureWatcher>
+#include <QImage>
 
 #include "../../../bin/lib/MapCreator/ui_MarkerViewerDialog.h"
 
 #include <SLAM/KeyFrame.h>
 
 #include <MapCreator/MarkerSelectorDialog.h>
+#include <Handler/FramePrefetcher.h>
 #include <glm/glm.hpp>
 
 namespace Ui {
@@ -30,7 +33,8 @@ namespace NiS {
 		MarkerViewerDialog ( const KeyFrames & keyframes , QWidget * parent = 0 );
 		MarkerViewerDialog ( QWidget * parent = 0 );
 
-		void SetKeyFrames ( const KeyFrames & keyframes );
+		// The frame loader restores the images of the keyframes released in streaming mode
+		void SetKeyFrames ( const KeyFrames & keyframes , const KeyFrameLoader & frame_loader = KeyFrameLoader ( ) );
 
 		inline PointPair GetPointPair ( ) const { return std::make_pair ( point1_ , point2_ ); }
 
@@ -44,6 +48,9 @@ namespace NiS {
 		void SetImage1 ( int index );
 		void SetImage2 ( int index );
 
+		void onImage1Loaded ( );
+		void onImage2Loaded ( );
+
 		void onFetchPoint1Done ( );
 		void onFetchPoint2Done ( );
 
@@ -59,8 +66,19 @@ namespace NiS {
 		glm::vec3 point2_;
 
 		void InitializeConnections ( );
-
-		KeyFrames keyframes_;
+		void InitializePrefetcher ( );
+		void SetImage ( int index , QLabel * label , QFutureWatcher < QImage > & watcher , int & loading_index );
+		KeyFrame GetKeyFrameWithImages ( int index ) const;
+
+		KeyFrames      keyframes_;
+		KeyFrameLoader frame_loader_;
+
+		// Scaled images of the keyframes, loaded around both slider positions in the background
+		FramePrefetcher < QImage > prefetcher_;
+		QFutureWatcher < QImage >  image_watcher1_;
+		QFutureWatcher < QImage >  image_watcher2_;
+		int                        loading_index1_;
+		int                        loading_index2_;
 
 		Ui::MarkerViewerDialog ui_;
 
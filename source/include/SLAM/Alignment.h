@@ -52,6 +52,9 @@ namespace NiS {
 			is_data_initialized_ = true;
 			has_answer_          = false;
 		}
+		// Streaming mode : frames come without images, tracking works from their key point points and the loader
+		// restores the images of the frames the answers are computed from.
+		void SetFrameLoader ( const KeyFrameLoader & loader ) { frame_loader_ = loader; }
 		void SetCoordinateConverter ( const XtionCoordinateConverter & converter ) {
 
 			xtion_converter_  = converter;
@@ -84,23 +87,23 @@ namespace NiS {
 			std::cout << "Computation begins" << std::endl;
 			switch ( converter_choice_ ) {
 				case 0: {
-					Tracker < type > tracker1 ( keyframes_ , options_ , xtion_converter_ );
+					Tracker < type > tracker1 ( std::move ( keyframes_ ) , options_ , xtion_converter_ );
 					do {
 						tracker1.ComputeNext ( );
 						emit Message ( tracker1.GetMessage ( ) );
 					}
 					while ( tracker1.Update ( ) );
-					keyframes_ = tracker1.GetResults ( );
+					keyframes_ = std::move ( tracker1 ).TakeResults ( );
 					break;
 				}
 				case 1: {
-					Tracker < type > tracker2 ( keyframes_ , options_ , aist_converter_ );
+					Tracker < type > tracker2 ( std::move ( keyframes_ ) , options_ , aist_converter_ );
 					do {
 						tracker2.ComputeNext ( );
 						emit Message ( tracker2.GetMessage ( ) );
 					}
 					while ( tracker2.Update ( ) );
-					keyframes_ = tracker2.GetResults ( );
+					keyframes_ = std::move ( tracker2 ).TakeResults ( );
 					break;
 				}
 				default:
@@ -163,6 +166,7 @@ namespace NiS {
 		AistCoordinateConverter                       aist_converter_;
 		bool                                          running_flag_;
 		bool                                          has_answer_;
+		KeyFrameLoader                                frame_loader_;
 		std::vector < std::pair < Points , Points > > all_markers_points_pairs_;
 
 	};
@@ -0,0 +1,60 @@
+#ifndef NIS_CALIBRATIONFITTER_H
+#define NIS_CALIBRATIONFITTER_H
+
+#include <vector>
+
+#include "SLAM/Calibrator.h"
+#include "SLAM/CommonDefinitions.h"
+#include "SLAM/CoordinateConverter.h"
+
+namespace NiS {
+
+	/*
+	 * Fits an internal calibration from depth images of a planar target (a flat wall filling the view) taken at
+	 * several distances.
+	 *
+	 * A plane is fitted to every frame with the Xtion model, and the depth of that plane along the ray of a pixel is
+	 * the reference depth of the pixel. The local polynomial of each pixel is the least squares fit of
+	 * depth * P(depth) = reference depth over the frames. Frames are reduced to per pixel sums as they are added, and
+	 * the pixels are solved in parallel.
+	 * The target gives no absolute scale, so the global correction is the identity and the fov polynomials are the
+	 * Xtion ones.
+	 */
+	class CalibrationFitter
+	{
+	public:
+
+		static const int kDefaultDegree     = 2;
+		static const int kDefaultMinSamples = 5;
+
+		CalibrationFitter ( int rows , int cols , int degree = kDefaultDegree );
+
+		// false when no plane is found in the frame
+		bool AddFrame ( const DepthImage & depth_image );
+
+		int GetFrameCount ( ) const { return frame_count_; }
+
+		// Pixels with less than min_samples frames keep their raw depth
+		InternalCalibrationInfo Fit ( int min_samples = kDefaultMinSamples ) const;
+
+	private:
+
+		// n . p + d = 0, |n| = 1
+		bool FitPlane ( const PointImage & points , cv::Vec4d & plane ) const;
+
+		int rows_;
+		int cols_;
+		int degree_;
+		int sum_count_;     // sums per pixel
+		int frame_count_;
+
+		XtionCoordinateConverter converter_;
+		PointImage               rays_;     // points of the pixels at 1 m
+
+		// Per pixel, depths t in metres : t^(m+2) for m in [0, 2 degree], t^(j+1) * reference for j in [0, degree], samples
+		std::vector < double > sums_;
+	};
+
+}
+
+#endif //NIS_CALIBRATIONFITTER_H
@@ -6,10 +6,13 @@
 #define LK_SLAM_CALIBRATOR_H
 
 
+#include <cstdint>
 #include <string>
 #include <opencv2/opencv.hpp>
 
 #include "SLAM/CommonDefinitions.h"
+#include "SLAM/FlatCalibrationTable.h"
+#include "SLAM/Polynomial.h"
 
 #include <Core/Serialize.h>
 
@@ -27,57 +30,58 @@ namespace NiS {
         using LocalCalibrationRow = std::vector<CoefficientsVector>;
         using LocalCalibrationTable = std::vector<LocalCalibrationRow>;
 
-        LocalCalibrationTable local_calibration_table;
+        FlatCalibrationTable local_calibration_table;
         CoefficientsVector global_calibration_vector;
         CoefficientsVector hfov_calibration_vector;
         CoefficientsVector vfov_calibration_vector;
 
         bool IsValid() const {
 
-            return !local_calibration_table.empty() and
+            return !local_calibration_table.IsEmpty() and
                    !global_calibration_vector.empty() and
                    !hfov_calibration_vector.empty() and
                    !vfov_calibration_vector.empty();
         }
     };
 
-    struct InternalCalibrationReader {
-        static InternalCalibrationInfo Read(const std::string &file_name) {
-
-            using namespace std;
-
-            std::ifstream in(file_name, std::ios::binary);
-
-            InternalCalibrationInfo info;
-
-            const std::string kFileHeader = "InternalCalibration";
-
-            if (in) {
+    /*
+     * Flat calibration file (.fcal), mapped and used in place.
+     *
+     *  FlatCalibrationHeader
+     *  global, hfov and vfov coefficients
+     *  coefficient counts   rows x cols bytes, at counts_offset
+     *  coefficient planes   coefficient_count planes of rows x cols floats, at planes_offset (64 byte aligned)
+     */
+    const char kFlatCalibrationMagic[16] = "NIS CALIBRATION";
+    const int kFlatCalibrationVersion = 1;
+    const std::string kFlatCalibrationExtension = ".fcal";
+
+    struct FlatCalibrationHeader {
+        char magic[16];
+        std::int32_t version;
+        std::int32_t rows;
+        std::int32_t cols;
+        std::int32_t coefficient_count;
+        std::int32_t global_count;
+        std::int32_t hfov_count;
+        std::int32_t vfov_count;
+        std::int32_t reserved;
+        std::uint64_t counts_offset;
+        std::uint64_t planes_offset;
+    };
 
-                const auto head = NiS::ReadString(in, static_cast < unsigned long >( kFileHeader.size()));
-                const auto version = NiS::Read<int>(in);
+    struct InternalCalibrationReader {
 
-                InternalCalibrationInfo::LocalCalibrationTable table(static_cast<unsigned long>(NiS::Read<int>(in)));
+        // .fcal files (found by their magic) are mapped, the others are read as .cal files
+        static InternalCalibrationInfo Read(const std::string &file_name);
 
-                for (auto &coef_line : table) {
-                    coef_line.resize(static_cast<unsigned long>(NiS::Read<int>(in)));
-                    for (auto &coef : coef_line) {
-                        coef = NiS::ReadVector<InternalCalibrationInfo::CoefficientsVector::value_type>(in);
-                    }
-                }
+        static InternalCalibrationInfo ReadCal(const std::string &file_name);
 
-                info.local_calibration_table = table;
-                info.global_calibration_vector = NiS::ReadVector<InternalCalibrationInfo::CoefficientsVector::value_type>(
-                        in);
-                info.hfov_calibration_vector = NiS::ReadVector<InternalCalibrationInfo::CoefficientsVector::value_type>(
-                        in);
-                info.vfov_calibration_vector = NiS::ReadVector<InternalCalibrationInfo::CoefficientsVector::value_type>(
-                        in);
+        static InternalCalibrationInfo ReadFlat(const std::string &file_name);
 
-            }
+        static bool WriteCal(const std::string &file_name, const InternalCalibrationInfo &info);
 
-            return info;
-        }
+        static bool WriteFlat(const std::string &file_name, const InternalCalibrationInfo &info);
     };
 
     class Calibrator {
@@ -86,14 +90,14 @@ namespace NiS {
         using LocalCalibrationTable = std::vector<LocalCalibrationRow>;
 
         struct InternalCalibrationData {
-            LocalCalibrationTable local_calibration_table;
+            FlatCalibrationTable local_calibration_table;
             CoefficientsVector global_calibration_vector;
             CoefficientsVector hfov_calibration_vector;
             CoefficientsVector vfov_calibration_vector;
 
             bool IsValid() const {
 
-                return !local_calibration_table.empty() and
+                return !local_calibration_table.IsEmpty() and
                        !global_calibration_vector.empty() and
                        !hfov_calibration_vector.empty() and
                        !vfov_calibration_vector.empty();
@@ -108,47 +112,42 @@ namespace NiS {
 
         ~Calibrator();
 
-        PointImage CalibrateImage(const cv::Mat &depth_image);
+        // Rows are converted in parallel tiles, 4 pixels at a time with SSE2
+        PointImage CalibrateImage(const cv::Mat &depth_image) const;
 
         inline bool IsValid() const {
 
             return internal_calibration_data_.IsValid();
         }
 
-        cv::Point2f WorldToScreen(cv::Point3f const &point, int rows, int cols);
+        cv::Point2f WorldToScreen(cv::Point3f const &point, int rows, int cols) const;
 
-        cv::Point3f ScreenToWorld(int row, int col, float depth, int rows, int cols);
+        cv::Point3f ScreenToWorld(int row, int col, float depth, int rows, int cols) const;
+
+        // Frames of another size than the calibration (other sensor, processing scale) use a resampled local table
+        void SetFrameSize(const cv::Size &size);
 
     private:
 
         InternalCalibrationData ReadHelper(const std::string &path);
 
-        float NthDegreeEquation(const CoefficientsVector &coef, float x) const {
-
-            float y = 0;
-            float xx = 1.0f;
-
-            for (const auto &c : coef) {
-                y += c * xx;
-                xx *= x;
-            }
-
-            return y;
-        }
+        // col_factors[col] = col / cols - 0.5
+        void CalibrateRow(int row, const ushort *depth, int rows, int cols, const float *col_factors,
+                          float *buffer, cv::Vec3f *points) const;
 
         float CorrectDepth(float depth) const {
 
             const CoefficientsVector &coef = internal_calibration_data_.global_calibration_vector;
-            return coef.empty() ? depth : depth * NthDegreeEquation(coef, depth);
+            return coef.empty() ? depth : depth * EvaluatePolynomial(coef, depth);
         }
 
         float CorrectDistortion(int row, int col, float depth) const {
 
-            const CoefficientsVector &coef = internal_calibration_data_.local_calibration_table[row][col];
-            return coef.empty() ? 0.0f : depth * NthDegreeEquation(coef, depth);
+            return local_calibration_table_.CorrectDistortion(row, col, depth);
         }
 
         InternalCalibrationData internal_calibration_data_;
+        FlatCalibrationTable local_calibration_table_;     // of the frame size
 
     };
 
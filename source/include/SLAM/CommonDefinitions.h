@@ -23,6 +23,14 @@ namespace NiS {
 		FixedFrameCount
 	};
 
+	// Frames are processed at their recorded size divided by the scale
+	enum class ProcessingScale : int
+	{
+		Full    = 1 ,
+		Half    = 2 ,
+		Quarter = 4
+	};
+
 	using PointPair = std::pair < glm::vec3 , glm::vec3 >;
 
 	using ScreenPoint = cv::Point2f;
@@ -0,0 +1,65 @@
+#ifndef NIS_COMPACTPOINTIMAGE_H
+#define NIS_COMPACTPOINTIMAGE_H
+
+#include <cstdint>
+#include <vector>
+
+#include <Core/Serialize.h>
+
+#include "SLAM/CommonDefinitions.h"
+
+namespace NiS {
+
+	/*
+	 * Point image stored as int16 millimetres (x, y, z interleaved) and a validity bitmap, 6 bytes and
+	 * a bit per point instead of 12 bytes. Points that are not finite or out of +-32.767 m are invalid and
+	 * come back as NaN, the others within 0.5 mm.
+	 */
+	class CompactPointImage
+	{
+	public:
+
+		CompactPointImage ( );
+		explicit CompactPointImage ( const PointImage & point_image );
+
+		int GetRows ( ) const { return rows_; }
+		int GetCols ( ) const { return cols_; }
+		bool IsEmpty ( ) const { return rows_ * cols_ == 0; }
+		std::size_t GetByteSize ( ) const { return xyz_.size ( ) * sizeof ( std::int16_t ) + valid_.size ( ) * sizeof ( std::uint64_t ); }
+
+		bool IsValid ( int row , int col ) const {
+
+			return ( valid_[ row * words_per_row_ + col / 64 ] >> ( col % 64 ) ) & 1;
+		}
+
+		WorldPoint At ( int row , int col ) const;
+
+		// Decodes a row into cols points, SSE2 when available.
+		void DecodeRow ( int row , cv::Vec3f * points ) const;
+
+		PointImage Decode ( ) const;
+
+	private:
+
+		friend class boost::serialization::access;
+
+		template < class Archive >
+		void serialize ( Archive & ar , const unsigned int version ) {
+
+			ar & rows_;
+			ar & cols_;
+			ar & words_per_row_;
+			ar & xyz_;
+			ar & valid_;
+		}
+
+		int                          rows_;
+		int                          cols_;
+		int                          words_per_row_;
+		std::vector < std::int16_t > xyz_;
+		std::vector < std::uint64_t > valid_;     // a bit per point, rows start on a word
+	};
+
+}
+
+#endif //NIS_COMPACTPOINTIMAGE_H
@@ -9,8 +9,10 @@
 
 #include <opencv2/opencv.hpp>
 #include <fstream>
+#include <vector>
 
 #include "SLAM/Calibrator.h"
+#include "SLAM/Polynomial.h"
 
 namespace NiS {
 
@@ -19,10 +21,32 @@ namespace NiS {
 	{
 	public:
 
+		CoordinateConverter ( ) :
+				frame_width_ ( XtionFrameProperty::kXtionWidth ) ,
+				frame_height_ ( XtionFrameProperty::kXtionHeight ) { }
+
+		virtual ~CoordinateConverter ( ) = default;
+
 		virtual ScreenPoint WorldToScreen ( const WorldPoint & world_point ) const { return ScreenPoint ( ); };
 
 		virtual WorldPoint ScreenToWorld ( const ScreenPoint & screen_point , ushort const depth ) const { return WorldPoint ( ); };
 
+		// ScreenToWorld of every pixel, converters override it with a batch kernel
+		virtual PointImage ConvertDepthImage ( const DepthImage & depth_image ) const;
+
+		// Size of the frames the screen points refer to, the Xtion frame by default. The fovs span the frame whatever
+		// its size, so frames of other sensors or scaled down frames only change the pixel pitch.
+		virtual void SetFrameSize ( const cv::Size & size ) {
+
+			frame_width_  = static_cast < float > ( size.width );
+			frame_height_ = static_cast < float > ( size.height );
+		}
+
+		cv::Size GetFrameSize ( ) const {
+
+			return cv::Size ( static_cast < int > ( frame_width_ ) , static_cast < int > ( frame_height_ ) );
+		}
+
 		struct XtionFrameProperty
 		{
 			static const float kXtionHorizontalFOV;
@@ -31,6 +55,11 @@ namespace NiS {
 			static const float kXtionHeight;
 		};
 
+	protected:
+
+		float frame_width_;
+		float frame_height_;
+
 	};
 
 	class XtionCoordinateConverter : public CoordinateConverter
@@ -38,8 +67,14 @@ namespace NiS {
 	public:
 
 		XtionCoordinateConverter ( ) :
-				universal_xz_factor_ ( GetXtionDepthFactor ( XtionFrameProperty::kXtionHorizontalFOV ) ) ,
-				universal_yz_factor_ ( GetXtionDepthFactor ( XtionFrameProperty::kXtionVerticalFOV ) ) { }
+				XtionCoordinateConverter ( XtionFrameProperty::kXtionHorizontalFOV , XtionFrameProperty::kXtionVerticalFOV ) { }
+
+		// Same model with other fovs, e.g. of the color camera depth images are registered to
+		XtionCoordinateConverter ( float hfov , float vfov ) :
+				universal_xz_factor_ ( GetXtionDepthFactor ( hfov ) ) ,
+				universal_yz_factor_ ( GetXtionDepthFactor ( vfov ) ) ,
+				x_rays_ ( MakeRays ( universal_xz_factor_ , frame_width_ , static_cast < int > ( frame_width_ ) ) ) ,
+				y_rays_ ( MakeRays ( -universal_yz_factor_ , frame_height_ , static_cast < int > ( frame_height_ ) ) ) { }
 
 		~XtionCoordinateConverter ( ) = default;
 
@@ -47,6 +82,11 @@ namespace NiS {
 
 		WorldPoint ScreenToWorld ( ScreenPoint const & screen_point , ushort const depth ) const override;
 
+		// point = depth * (x ray of the column, y ray of the row, -1) in one pass, SSE2 and AVX2 (when the CPU has it)
+		PointImage ConvertDepthImage ( const DepthImage & depth_image ) const override;
+
+		void SetFrameSize ( const cv::Size & size ) override;
+
 	private:
 
 		float GetXtionDepthFactor ( float fov ) {
@@ -54,9 +94,17 @@ namespace NiS {
 			return tanf ( fov / 2 ) * 2;
 		}
 
+		// factor * (i / size - 0.5) for i in [0, count)
+		static std::vector < float > MakeRays ( float factor , float size , int count );
+
 		float universal_xz_factor_;
 		float universal_yz_factor_;
 
+		// Per column and per row ray components of the frame in metres per millimetre of depth, the ray of a pixel is
+		// (x_rays_[col], y_rays_[row], -1)
+		std::vector < float > x_rays_;
+		std::vector < float > y_rays_;
+
 	};
 
 	class AistCoordinateConverter : public CoordinateConverter
@@ -68,41 +116,32 @@ namespace NiS {
 		inline AistCoordinateConverter ( std::string const & file_name ) {
 
 			internal_calibration_info_ = InternalCalibrationReader::Read ( file_name );
+			local_calibration_table_   = internal_calibration_info_.local_calibration_table;
 		}
 
 		ScreenPoint WorldToScreen ( WorldPoint const & world_point ) const override;
 
 		WorldPoint ScreenToWorld ( ScreenPoint const & screen_point , ushort const depth ) const override;
 
-	private:
+		// The local calibration is resampled to the frame size
+		void SetFrameSize ( const cv::Size & size ) override;
 
+	private:
 
-		float NthDegreeEquation ( const InternalCalibrationInfo::CoefficientsVector & coef , float x ) const {
-
-			float y  = 0;
-			float xx = 1.0f;
-
-			for ( const auto & c : coef ) {
-				y += c * xx;
-				xx *= x;
-			}
-
-			return y;
-		}
 
 		float CorrectDepth ( float depth ) const {
 
-			const auto & coef = internal_calibration_info_.global_calibration_vector;
-			return coef.empty ( ) ? depth : depth * NthDegreeEquation ( coef , depth );
+			const InternalCalibrationInfo::CoefficientsVector & coef = internal_calibration_info_.global_calibration_vector;
+			return coef.empty ( ) ? depth : depth * EvaluatePolynomial ( coef , depth );
 		}
 
 		float CorrectDistortion ( int row , int col , float depth ) const {
 
-			const auto & coef = internal_calibration_info_.local_calibration_table[ row ][ col ];
-			return coef.empty ( ) ? 0.0f : depth * NthDegreeEquation ( coef , depth );
+			return local_calibration_table_.CorrectDistortion ( row , col , depth );
 		}
 
 		InternalCalibrationInfo internal_calibration_info_;
+		FlatCalibrationTable    local_calibration_table_;     // of the frame size
 
 	};
 };
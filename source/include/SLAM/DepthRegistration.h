@@ -0,0 +1,79 @@
+#ifndef NIS_DEPTHREGISTRATION_H
+#define NIS_DEPTHREGISTRATION_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SLAM/CommonDefinitions.h"
+#include "SLAM/CoordinateConverter.h"
+
+namespace NiS {
+
+	/*
+	 * Warps depth images into the color frame for recordings whose color and depth pixels are not aligned, so that the
+	 * point of a color key point is read at the key point.
+	 *
+	 * Both cameras follow the Xtion model (fovs spanning the frame, whatever its size), the color one is moved by the
+	 * extrinsics. The rotated ray of every depth pixel is precomputed, a depth pixel is then depth * ray + translation
+	 * in the color frame. Its projection runs 4 pixels at a time with SSE2 and is splatted on the 2 x 2 color pixels
+	 * around it, the nearest depth wins (z-buffer). Color pixels that no depth pixel reaches are 0 like missing depth.
+	 */
+	class DepthRegistration
+	{
+	public:
+
+		static const std::string kFileExtension;
+
+		// Identity : nothing to register
+		DepthRegistration ( );
+
+		// depth_to_color takes depth camera points to color camera points, in metres
+		explicit DepthRegistration ( const glm::mat4 & depth_to_color ,
+		                             float color_hfov = CoordinateConverter::XtionFrameProperty::kXtionHorizontalFOV ,
+		                             float color_vfov = CoordinateConverter::XtionFrameProperty::kXtionVerticalFOV );
+
+		// Text file : the 16 values of depth_to_color row by row, optionally followed by the color fovs in radians.
+		// Identity when the file cannot be read.
+		static DepthRegistration Read ( const std::string & file_name );
+
+		bool IsIdentity ( ) const { return identity_; }
+
+		const glm::mat4 & GetExtrinsics ( ) const { return depth_to_color_; }
+
+		// Fovs of the registered depth images, to convert them to points
+		float GetColorHorizontalFOV ( ) const { return color_hfov_; }
+		float GetColorVerticalFOV ( ) const { return color_vfov_; }
+
+		// Of the extrinsics and the fovs, 0 for the identity (see RegisteredFeatureParameters)
+		std::uint64_t Hash ( ) const;
+
+		// Depth image of the color frame, same size as depth_image. depth_image itself for the identity.
+		DepthImage Register ( const DepthImage & depth_image ) const;
+
+	private:
+
+		// Rotated rays of the depth pixels in metres per millimetre of depth, one plane per component
+		struct RayTables
+		{
+			int                   rows;
+			int                   cols;
+			std::vector < float > x;
+			std::vector < float > y;
+			std::vector < float > z;
+		};
+
+		RayTables MakeRayTables ( int rows , int cols ) const;
+
+		bool      identity_;
+		glm::mat4 depth_to_color_;
+		float     color_hfov_;
+		float     color_vfov_;
+		float     color_xz_factor_;
+		float     color_yz_factor_;
+		RayTables rays_;     // of the Xtion frame, other sizes get their own
+	};
+
+}
+
+#endif //NIS_DEPTHREGISTRATION_H
@@ -0,0 +1,71 @@
+#ifndef NIS_DESCRIPTORMATCHER_H
+#define NIS_DESCRIPTORMATCHER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+namespace NiS {
+
+	// Nearest neighbours of both sets of a pair, the first of the equally near ones (lowest index)
+	template < class Distance >
+	struct NearestNeighbours
+	{
+		std::vector < int >      index1;        // for each descriptor of the 1st set, its nearest in the 2nd
+		std::vector < Distance > distance1;
+		std::vector < int >      index2;        // for each descriptor of the 2nd set, its nearest in the 1st
+		std::vector < Distance > distance2;
+
+		bool IsMutual ( int i ) const { return index1[ i ] >= 0 and index2[ index1[ i ] ] == i; }
+	};
+
+	/*
+	 * Binary descriptors (ORB, FREAK) in the layout of the Hamming kernels : contiguous rows of 64 bit words padded
+	 * to 32 bytes (zeros do not change the distances), aligned for the vector loads.
+	 */
+	class BinaryDescriptors
+	{
+	public:
+
+		static const int kRowAlignment = 32;
+
+		// CV_8U descriptors, one per row
+		explicit BinaryDescriptors ( const cv::Mat & descriptors );
+
+		// data_ points into buffer_
+		BinaryDescriptors ( const BinaryDescriptors & ) = delete;
+		BinaryDescriptors & operator = ( const BinaryDescriptors & ) = delete;
+		BinaryDescriptors ( BinaryDescriptors && ) = default;
+
+		int GetCount ( ) const { return count_; }
+		int GetWords ( ) const { return words_; }
+
+		const std::uint64_t * GetRow ( int i ) const { return data_ + static_cast < std::size_t > ( i ) * words_; }
+
+	private:
+
+		int                           count_;
+		int                           words_;         // per row, a multiple of 4
+		std::vector < std::uint64_t > buffer_;
+		std::uint64_t               * data_;          // aligned in buffer_
+	};
+
+	/*
+	 * Exact Hamming nearest neighbours of both directions in a single pass over the distance matrix. The matrix is
+	 * computed by blocks of rows of both sets that stay in L1, the row and column minima are updated from each block.
+	 * The distances are popcounts of the xor of the rows : AVX-512 VPOPCNTDQ, AVX2 (nibble lookup), popcnt or the
+	 * software popcount, whichever the CPU supports (checked at run time on x86).
+	 */
+	NearestNeighbours < int > MatchHamming ( const BinaryDescriptors & descriptors1 , const BinaryDescriptors & descriptors2 );
+
+	/*
+	 * Exact Euclidean nearest neighbours of float descriptors (SIFT, SURF) of both directions. The squared distances
+	 * |a|^2 + |b|^2 - 2ab of a block of rows of both sets come from one SGEMM (cv::gemm) of the blocks, the row and
+	 * column minima are updated from each block. Unlike the FLANN trees, the results do not depend on the index.
+	 */
+	NearestNeighbours < float > MatchL2 ( const cv::Mat & descriptors1 , const cv::Mat & descriptors2 );
+
+}
+
+#endif //NIS_DESCRIPTORMATCHER_H
@@ -0,0 +1,65 @@
+#ifndef NIS_FLATCALIBRATIONTABLE_H
+#define NIS_FLATCALIBRATIONTABLE_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace NiS {
+
+	/*
+	 * Local (per pixel) calibration coefficients baked into one plane per coefficient, rows x cols floats each.
+	 * Pixels with fewer coefficients than the others are padded with zeros, which leaves their polynomial unchanged,
+	 * and a plane of bytes keeps the number of coefficients of each pixel. The data is either owned or a view of a
+	 * mapped .fcal file kept alive by storage, copies share it.
+	 */
+	class FlatCalibrationTable
+	{
+	public:
+
+		using CoefficientsVector    = std::vector < float >;
+		using LocalCalibrationTable = std::vector < std::vector < CoefficientsVector > >;
+
+		FlatCalibrationTable ( );
+		explicit FlatCalibrationTable ( const LocalCalibrationTable & table );
+		FlatCalibrationTable ( int rows , int cols , int coefficient_count , const std::uint8_t * counts , const float * planes ,
+		                       std::shared_ptr < const void > storage );
+		// Owns the counts (rows x cols) and the planes (coefficient_count x rows x cols)
+		FlatCalibrationTable ( int rows , int cols , int coefficient_count , std::vector < std::uint8_t > counts ,
+		                       std::vector < float > planes );
+
+		int GetRows ( ) const { return rows_; }
+		int GetCols ( ) const { return cols_; }
+		int GetCoefficientCount ( ) const { return coefficient_count_; }
+		bool IsEmpty ( ) const { return rows_ * cols_ == 0; }
+
+		// coefficient_count planes of rows x cols
+		const float * GetPlanes ( ) const { return planes_; }
+		const float * GetPlane ( int k ) const { return planes_ + static_cast < std::size_t > ( k ) * rows_ * cols_; }
+
+		// rows x cols coefficient counts
+		const std::uint8_t * GetCounts ( ) const { return counts_; }
+
+		// depth * (c0 + c1 depth + ...) of the pixel, 0 outside of the table like a pixel without coefficients
+		float CorrectDistortion ( int row , int col , float depth ) const;
+
+		// CorrectDistortion of count pixels of a row from col, SSE2 when available
+		void CorrectDistortionRow ( int row , int col , int count , const float * depth , float * corrected ) const;
+
+		// Table of frames of rows x cols, a pixel takes the coefficients of the pixel of the table it was sampled
+		// from (nearest, like a depth image resized with cv::INTER_NEAREST). Shares the data for the same size.
+		FlatCalibrationTable Resample ( int rows , int cols ) const;
+
+	private:
+
+		int                            rows_;
+		int                            cols_;
+		int                            coefficient_count_;
+		const std::uint8_t           * counts_;
+		const float                  * planes_;
+		std::shared_ptr < const void > storage_;
+	};
+
+}
+
+#endif //NIS_FLATCALIBRATIONTABLE_H
@@ -82,11 +82,11 @@ namespace NiS {
 			int values ( ) const { return values_; }
 
 		private:
-			const int                 inputs_;
-			const int                 values_;
-			const CoordinateConverter coordinate_converter_;
-			const Points              world_points1_;
-			const Points              world_points2_;
+			const int                   inputs_;
+			const int                   values_;
+			const CoordinateConverter & coordinate_converter_;     // a copy would be sliced to the base class
+			const Points                world_points1_;
+			const Points                world_points2_;
 		};
 
 	};
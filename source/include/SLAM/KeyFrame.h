@@ -7,23 +7,31 @@
 
 #include <Core/Serialize.h>
 #include <Core/Feature.h>
+#include <Core/FeatureExtractor.h>
+#include <Core/FeatureStore.h>
 
 #include "SLAM/Calibrator.h"
 #include "SLAM/CommonDefinitions.h"
+#include "SLAM/PointImageCache.h"
 
 #include <QDir>
 #include <QFileInfo>
 
+#include <functional>
+#include <limits>
+#include <memory>
+
 namespace NiS {
 
 	class KeyFrame
 	{
 	public:
 
-		KeyFrame ( const std::string & name , const PointImage & point_image , const ColorImage & color_image ,
-		           const Feature::Type & type = Feature::Type::kTypeSIFT ) :
+		KeyFrame ( const std::string & name , const DepthImage & depth_image , const std::shared_ptr < PointImageCache > & point_images ,
+		           const ColorImage & color_image , const Feature::Type & type = Feature::Type::kTypeSIFT ) :
 				name_ ( name ) ,
-				point_image_ ( point_image ) ,
+				depth_image_ ( depth_image ) ,
+				point_images_ ( point_images ) ,
 				color_image_ ( color_image ) ,
 				type_ ( type ) ,
 				is_used_ ( false ) {
@@ -37,21 +45,98 @@ namespace NiS {
 		// Setters
 		void SetId ( const int & id ) { id_ = id; }
 		void SetName ( const std::string & name ) { name_ = name; }
+		// The feature is not created here, see CreateFeature
 		void SetColorImage ( const ColorImage & color_image , const Feature::Type & type = Feature::Type::kTypeSIFT ) {
 
 			type_        = type;
 			color_image_ = color_image;
-			CreateFeature ( );
 		}
-		void SetPointImage ( const PointImage & point_image ) { point_image_ = point_image; }
+		// Point images are computed from the depth image by the cache when asked for
+		void SetDepthImage ( const DepthImage & depth_image , const std::shared_ptr < PointImageCache > & point_images ) {
+
+			depth_image_  = depth_image;
+			point_images_ = point_images;
+		}
+		// Keeps the (mapped) file the images refer to alive
+		void SetImageStorage ( const std::shared_ptr < void > & storage ) { storage_ = storage; }
+		// Identifies the feature in the feature store along with the frame and the type (scaled images differ)
+		void SetFeatureParameters ( std::uint64_t parameters ) { feature_parameters_ = parameters; }
+		// Used by ExtractFeature, the feature parameters have to follow them (DetectionParameters::Hash)
+		void SetDetectionParameters ( const DetectionParameters & parameters ) { detection_parameters_ = parameters; }
 		void SetAlignmentMatrix ( const glm::mat4 & mat ) { alignment_matrix_ = mat; }
 		void SetAnswerAlignmentMatrix ( const glm::mat4 & mat ) { marker_alignment_matrix_ = mat; }
 		void SetUsed ( bool is_used ) { is_used_ = is_used; }
 
+		// Streaming mode : images are released once the features and the key point points are computed and
+		// restored on demand (KeyFrameLoader), the feature and the matrices are kept all the time.
+		void RestoreImages ( const ColorImage & color_image , const DepthImage & depth_image ,
+		                     const std::shared_ptr < void > & storage = std::shared_ptr < void > ( ) ) {
+
+			color_image_ = color_image;
+			depth_image_ = depth_image;
+			storage_     = storage;
+		}
+		void ReleaseImages ( ) {
+
+			if ( point_images_ ) point_images_->Erase ( id_ );
+
+			color_image_.release ( );
+			depth_image_.release ( );
+			storage_.reset ( );
+		}
+		bool HasImages ( ) const { return !depth_image_.empty ( ); }
+
+		// Feature of the color image, the steps of CreateFeature can be scheduled on their own :
+		// LoadStoredFeature (feature store or legacy .feature file), then ExtractFeature from GetGrayImage when not stored.
+		void CreateFeature ( );
+		bool LoadStoredFeature ( );
+		cv::Mat_ < uchar > GetGrayImage ( ) const;
+		void ExtractFeature ( const cv::Mat_ < uchar > & gray_image );
+		// Feature extracted elsewhere (e.g. a FeatureExtractor batch), kept and stored as ExtractFeature does
+		void SetExtractedFeature ( const Feature & feature );
+
+		// 3D points of the key points of the feature (NaN without depth), kept when the images are released
+		// so that tracking does not need the images. CreateFeature computes them.
+		void ComputeKeyPointPoints ( );
+		bool HasKeyPointPoints ( ) const {
+
+			return !key_point_points_.empty ( ) and key_point_points_.size ( ) == feature_.GetKeyPoints ( ).size ( );
+		}
+		// Computed from the depth image when not kept
+		WorldPoint GetKeyPointPoint ( int index ) const {
+
+			if ( HasKeyPointPoints ( ) ) {
+				return key_point_points_[ index ];
+			}
+
+			const auto & pt = feature_.GetKeyPoints ( )[ index ].pt;
+			return GetPoint ( cvRound ( pt.y ) , cvRound ( pt.x ) );
+		}
+
 		// Getters
 		int GetId ( ) const { return id_; }
 		const ColorImage & GetColorImage ( ) const { return color_image_; }
-		const PointImage & GetPointImage ( ) const { return point_image_; }
+		const DepthImage & GetDepthImage ( ) const { return depth_image_; }
+		// Whole point image, prefer GetPoint for a few points
+		PointImage GetPointImage ( ) const {
+
+			return HasImages ( ) and point_images_ ? point_images_->Get ( id_ , depth_image_ ) : PointImage ( );
+		}
+		// Compact (int16 millimetre) point image, empty without images
+		std::shared_ptr < const CompactPointImage > GetCompactPointImage ( ) const {
+
+			return HasImages ( ) and point_images_ ? point_images_->GetCompact ( id_ , depth_image_ ) : nullptr;
+		}
+		// NaN outside of the image or without depth
+		WorldPoint GetPoint ( int row , int col ) const {
+
+			if ( !point_images_ or row < 0 or col < 0 or row >= depth_image_.rows or col >= depth_image_.cols ) {
+				const float nan = std::numeric_limits < float >::quiet_NaN ( );
+				return WorldPoint ( nan , nan , nan );
+			}
+
+			return point_images_->GetConverter ( ).ConvertPoint ( depth_image_ , row , col );
+		}
 		const std::string & GetName ( ) const { return name_; }
 		const NiS::Feature & GetFeature ( ) const { return feature_; }
 		const NiS::Feature::Type & GetFeatureType ( ) const { return type_; }
@@ -68,10 +153,10 @@ namespace NiS {
 		template < class Archive > void save ( Archive & ar , const unsigned int version ) const {
 
 			const cv::Mat color = color_image_;
-			const cv::Mat point = point_image_;
+			const cv::Mat depth = depth_image_;
 
 			ar & color;
-			ar & point;
+			ar & depth;
 			ar & name_;
 			ar & feature_;
 
@@ -79,77 +164,49 @@ namespace NiS {
 		template < class Archive > void load ( Archive & ar , const unsigned int version ) {
 
 			cv::Mat     color;
-			cv::Mat     point;
+			cv::Mat     depth;
 			std::string name;
 			Feature     feature;
 
 			ar & color;
-			ar & point;
+			ar & depth;
 			ar & name;
 			ar & feature;
 
 			color_image_ = color;
-			point_image_ = point;
+			depth_image_ = depth;
 			name_        = name;
 			feature_     = feature;
 		}
 
-		inline void CreateFeature ( ) {
-
-			QFileInfo info ( QString::fromStdString ( name_ ) );
-
-			auto path = info.absolutePath ( );
-			auto name = info.completeBaseName ( );
-
-
-			QString feature_prefix;
-			switch ( type_ ) {
-				case Feature::Type::kTypeSIFT:
-					feature_prefix = "SIFT/sift_";
-					break;
-				case Feature::Type::kTypeSURF:
-					feature_prefix = "SURF/surf_";
-					break;
-				case Feature::Type::kTypeFREAK:
-					feature_prefix = "FREAK/freak_";
-					break;
-				case Feature::Type::kTypeORB:
-					feature_prefix = "ORB/orb_";
-					break;
-				default:
-					break;
-			}
-
-			QString feature_folder_path = path + "/Features/";
-
-			QDir dir ( feature_folder_path );
-			if ( !dir.exists ( ) ) dir.mkdir ( feature_folder_path );
-
-			if ( !LoadFeature ( ( feature_folder_path + name + "." + "feature" ).toStdString ( ) , feature_ ) ) {
-				assert( !color_image_.empty ( ) );
-				cv::Mat cvt_color_image;
-				cv::cvtColor ( color_image_ , cvt_color_image , cv::COLOR_RGB2GRAY );
-				feature_ = NiS::Feature ( cvt_color_image , type_ );
-				SaveFeature ( QString ( feature_folder_path + name + ".feature" ).toStdString ( ) , feature_ );
-			}
-		}
+		// Store of the dataset directory and key of the feature
+		std::shared_ptr < FeatureStore > OpenFeatureStore ( FeatureKey & key , QString & legacy_file_name ) const;
 
 	private: // Fields
 
-		int                id_;
-		bool               is_used_;
-		glm::mat4          marker_alignment_matrix_;
-		glm::mat4          alignment_matrix_;
-		std::string        name_;
-		NiS::Feature       feature_;
-		NiS::Feature::Type type_;
-		PointImage         point_image_;
-		ColorImage         color_image_;
+		int                 id_;
+		bool                is_used_;
+		glm::mat4           marker_alignment_matrix_;
+		glm::mat4           alignment_matrix_;
+		std::string         name_;
+		NiS::Feature        feature_;
+		NiS::Feature::Type  type_;
+		std::uint64_t       feature_parameters_ = DetectionParameters ( ).Hash ( );
+		DetectionParameters detection_parameters_;
+		Points              key_point_points_;
+		DepthImage          depth_image_;
+		ColorImage          color_image_;
+
+		std::shared_ptr < PointImageCache > point_images_;
+		std::shared_ptr < void >            storage_;
 
 	};
 
 	using KeyFrames = std::vector < KeyFrame >;
 
+	// Restores the images of a keyframe whose images have been released.
+	using KeyFrameLoader = std::function < void ( KeyFrame & ) >;
+
 }
 
 #endif //NIS_KEYFRAME_H
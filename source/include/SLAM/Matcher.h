@@ -19,10 +19,17 @@ namespace NiS {
         typedef std::vector<Match> Matches;    ///< ２つの Feature から得られる Match たち
         typedef PointCloud::PointImage PointImage;
 
-        Matcher(const Feature &feature1, const Feature &feature2, bool cross_check);
+        /// 記述子の対応付けの方法
+        enum Backend {
+            kBackendExact,     ///< 総当たりの最近傍（Hamming はポップカウント、L2 は SGEMM、SLAM/DescriptorMatcher.h）
+            kBackendOpenCV     ///< OpenCV の matcher（SIFT / SURF は FLANN の近似最近傍）
+        };
+
+        Matcher(const Feature &feature1, const Feature &feature2, bool cross_check,
+                Backend backend = kBackendExact);
 
         Matcher(const Feature &feature1, const Feature &feature2, const PointImage &point_image1,
-                const PointImage &point_image2, bool cross_check);
+                const PointImage &point_image2, bool cross_check, Backend backend = kBackendExact);
 
         Matcher(const Matches &matches);
 
@@ -36,11 +43,12 @@ namespace NiS {
 
         Matches matches_;
 
-        Matches CreateMatches(const Feature &feature1, const Feature &feature2, bool cross_check) const;
+        Matches CreateMatches(const Feature &feature1, const Feature &feature2, bool cross_check,
+                              Backend backend) const;
 
         Matches CreateValidMatches(const Feature &feature1, const Feature &feature2,
                                    const PointImage &point_image1, const PointImage &point_image2,
-                                   bool cross_check) const;
+                                   bool cross_check, Backend backend) const;
     };
 };
 
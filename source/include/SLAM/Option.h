@@ -7,6 +7,7 @@
 
 #include <QString>
 
+#include <Core/FeatureExtractor.h>
 #include <Core/Serialize.h>
 #include "SLAM/CommonDefinitions.h"
 
@@ -166,6 +167,7 @@ namespace NiS {
 		Options_OneByOne        options_one_by_one;
 		Options_FixedFrameCount options_fixed_frame_count;
 		Options_PcaKeyFrame     options_pca_keyframe;
+		DetectionParameters     options_detection;     // used when the frames are converted
 
 		TrackingType GetType ( ) const { return type_; }
 
@@ -186,6 +188,13 @@ namespace NiS {
 			ar & options_one_by_one;
 			ar & options_fixed_frame_count;
 			ar & options_pca_keyframe;
+
+			// Caches of version 0 have no detection parameters : all the key points
+			if ( version >= 1 ) {
+				ar & options_detection;
+			} else {
+				options_detection = DetectionParameters ( );
+			}
 		}
 	};
 
@@ -200,4 +209,6 @@ namespace NiS {
 
 }
 
+BOOST_CLASS_VERSION( NiS::Options , 1 )
+
 #endif //NIS_OPTION_H
@@ -0,0 +1,106 @@
+#ifndef NIS_POINTIMAGECACHE_H
+#define NIS_POINTIMAGECACHE_H
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "SLAM/Calibrator.h"
+#include "SLAM/CommonDefinitions.h"
+#include "SLAM/CompactPointImage.h"
+#include "SLAM/CoordinateConverter.h"
+
+namespace NiS {
+
+	// Turns depth pixels into world points.
+	class DepthConverter
+	{
+	public:
+
+		virtual ~DepthConverter ( ) = default;
+
+		virtual WorldPoint ConvertPoint ( const DepthImage & depth_image , int row , int col ) const = 0;
+
+		virtual PointImage ConvertImage ( const DepthImage & depth_image ) const;
+	};
+
+	// Xtion or AIST conversion
+	class CoordinateDepthConverter : public DepthConverter
+	{
+	public:
+
+		explicit CoordinateDepthConverter ( std::shared_ptr < const CoordinateConverter > converter ) :
+				converter_ ( std::move ( converter ) ) { }
+
+		WorldPoint ConvertPoint ( const DepthImage & depth_image , int row , int col ) const override;
+
+		PointImage ConvertImage ( const DepthImage & depth_image ) const override;
+
+	private:
+
+		std::shared_ptr < const CoordinateConverter > converter_;
+	};
+
+	// Internal calibration
+	class CalibratedDepthConverter : public DepthConverter
+	{
+	public:
+
+		explicit CalibratedDepthConverter ( const Calibrator & calibrator ) :
+				calibrator_ ( calibrator ) { }
+
+		WorldPoint ConvertPoint ( const DepthImage & depth_image , int row , int col ) const override;
+
+		PointImage ConvertImage ( const DepthImage & depth_image ) const override;
+
+	private:
+
+		Calibrator calibrator_;
+	};
+
+	/*
+	 * Point images of the keyframes of a conversion, computed from their depth images on demand.
+	 * Only the capacity most recently used point images are kept, as CompactPointImages in compact mode. Thread safe.
+	 */
+	class PointImageCache
+	{
+	public:
+
+		static const std::size_t kDefaultCapacity = 16;
+
+		explicit PointImageCache ( std::shared_ptr < const DepthConverter > converter ,
+		                           std::size_t capacity = kDefaultCapacity , bool compact = false );
+
+		const DepthConverter & GetConverter ( ) const { return * converter_; }
+		bool IsCompact ( ) const { return compact_; }
+
+		// id identifies the depth image among the ones of the cache (the keyframe id)
+		PointImage Get ( int id , const DepthImage & depth_image );
+		std::shared_ptr < const CompactPointImage > GetCompact ( int id , const DepthImage & depth_image );
+		void Erase ( int id );
+
+	private:
+
+		struct Entry
+		{
+			PointImage                                  point_image;
+			std::shared_ptr < const CompactPointImage > compact_point_image;
+			std::list < int >::iterator                 recent;
+		};
+
+		bool Find ( int id , Entry & entry );
+		void Insert ( int id , Entry entry );
+
+		std::shared_ptr < const DepthConverter > converter_;
+		std::size_t                             capacity_;
+		bool                                    compact_;
+
+		std::mutex             mutex_;
+		std::map < int , Entry > point_images_;
+		std::list < int >      recent_;     // most recently used first
+	};
+
+}
+
+#endif //NIS_POINTIMAGECACHE_H
@@ -0,0 +1,27 @@
+#ifndef NIS_POLYNOMIAL_H
+#define NIS_POLYNOMIAL_H
+
+#include <vector>
+
+namespace NiS {
+
+	// c0 + c1 x + c2 x^2 + ... by Horner's rule, 0 without coefficients. The depth only terms of the calibration
+	// have 1 to 3 coefficients : this is cheaper than a sampled table and exact.
+	inline float EvaluatePolynomial ( const std::vector < float > & coefficients , float x ) {
+
+		if ( coefficients.empty ( ) ) {
+			return 0.0f;
+		}
+
+		float y = coefficients.back ( );
+
+		for ( auto k = static_cast < int > ( coefficients.size ( ) ) - 2 ; k >= 0 ; --k ) {
+			y = y * x + coefficients[ k ];
+		}
+
+		return y;
+	}
+
+}
+
+#endif //NIS_POLYNOMIAL_H
@@ -20,6 +20,7 @@
 
 namespace NiS {
 
+	// From the key point points kept by the keyframes : released frames (streaming mode) are tracked without their images
 	CorrespondingPointsPair CreateCorrespondingPointsPair ( const NiS::KeyFrame & key_frame1 , const NiS::KeyFrame & key_frame2 );
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -41,10 +42,10 @@ namespace NiS {
 			options_ = options;
 		}
 		Tracker ( const Tracker & other ) = default;
-		Tracker ( const KeyFrames & keyframes , const Options & options , const XtionCoordinateConverter & converter ) {
+		Tracker ( KeyFrames keyframes , const Options & options , const XtionCoordinateConverter & converter ) {
 
 			options_                    = options;
-			keyframes_                  = keyframes;
+			keyframes_                  = std::move ( keyframes );
 			xtion_coordinate_converter_ = converter;
 			converter_choice_           = 0;
 			converter_pointer_          = & xtion_coordinate_converter_;
@@ -53,10 +54,10 @@ namespace NiS {
 
 			Initialize ( );
 		}
-		Tracker ( const KeyFrames & keyframes , const Options & options , const AistCoordinateConverter & converter ) {
+		Tracker ( KeyFrames keyframes , const Options & options , const AistCoordinateConverter & converter ) {
 
 			options_                   = options;
-			keyframes_                 = keyframes;
+			keyframes_                 = std::move ( keyframes );
 			aist_coordinate_converter_ = converter;
 			converter_choice_          = 1;
 			converter_pointer_         = & aist_coordinate_converter_;
@@ -75,7 +76,9 @@ namespace NiS {
 		QString GetMessage ( ) const { return message_; };
 		const KeyFramesIterator & GetIterator1 ( ) const { return iterator1_; }
 		const KeyFramesIterator & GetIterator2 ( ) const { return iterator2_; }
-		const KeyFrames GetResults ( ) const { return keyframes_; }
+		const KeyFrames & GetResults ( ) const { return keyframes_; }
+		// Moves the keyframes out of a finished tracker : keyframes_ = std::move ( tracker ).TakeResults ( )
+		KeyFrames TakeResults ( ) && { return std::move ( keyframes_ ); }
 
 	private:
 
@@ -463,7 +463,7 @@ namespace NiS {
 		keyframes_gl_.clear ( );
 		for ( auto const & keyframe : keyframes ) {
 
-			KeyFrameGL keyframe_gl ( GL , keyframe , density_step_ );
+			KeyFrameGL keyframe_gl ( GL , keyframe , density_step_ , frame_loader_ );
 			keyframe_gl.SetShaderProgram ( shader_program_ );
 			keyframe_gl.SetupData ( );
 			keyframes_gl_.push_back ( keyframe_gl );
@@ -556,8 +556,8 @@ namespace NiS {
 		if ( keyframes.size ( ) == 2 ) {
 
 			keyframes_gl_for_inliers_.clear ( );
-			keyframes_gl_for_inliers_.push_back ( KeyFrameGL ( GL , keyframes[ 0 ] , density_step_ ) );
-			keyframes_gl_for_inliers_.push_back ( KeyFrameGL ( GL , keyframes[ 1 ] , density_step_ ) );
+			keyframes_gl_for_inliers_.push_back ( KeyFrameGL ( GL , keyframes[ 0 ] , density_step_ , frame_loader_ ) );
+			keyframes_gl_for_inliers_.push_back ( KeyFrameGL ( GL , keyframes[ 1 ] , density_step_ , frame_loader_ ) );
 
 			keyframes_gl_for_inliers_[ 0 ].SetShaderProgram ( shader_program_ );
 			keyframes_gl_for_inliers_[ 1 ].SetShaderProgram ( shader_program_ );
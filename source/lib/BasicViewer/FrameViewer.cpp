@@ -8,9 +8,11 @@
 
 #include <QFileDialog>
 #include <QImage>
+#include <QtConcurrent>
 
 
 #include <Handler/ImageDataHandler.h>
+#include <Core/SequenceFile.h>
 
 #include <aruco/aruco.h>
 #include <aruco/cvdrawingutils.h>
@@ -19,7 +21,17 @@
 
 namespace NiS {
 
-	FrameViewer::FrameViewer ( QWidget * parent ) {
+	namespace {
+
+		// Frames decoded ahead on each side of the current one, and the decoded frames kept
+		const int kPrefetchRadius = 8;
+		const int kFrameCacheSize = 4 * kPrefetchRadius;
+	}
+
+	FrameViewer::FrameViewer ( QWidget * parent ) :
+			has_marker_ ( false ) ,
+			prefetcher_ ( kFrameCacheSize ) ,
+			loading_row_ ( -1 ) {
 
 		ui_.setupUi ( this );
 
@@ -28,6 +40,9 @@ namespace NiS {
 		connect ( ui_.PushButton_Clear , & QPushButton::clicked , this , & FrameViewer::onClearButtonPushed );
 		connect ( ui_.PushButton_TryDetection , & QPushButton::clicked , this , & FrameViewer::onTryDetection );
 		connect ( ui_.ListWidget_FileList , SIGNAL( currentRowChanged ( int ) ) , this , SLOT( onFileListCurrentItemChanged ( int ) ) );
+		connect ( & frame_watcher_ , SIGNAL( finished ( ) ) , this , SLOT( onFrameLoaded ( ) ) );
+		connect ( & detection_watcher_ , SIGNAL( resultReadyAt ( int ) ) , this , SLOT( onDetectionResultReady ( int ) ) );
+		connect ( & detection_watcher_ , SIGNAL( finished ( ) ) , this , SLOT( onDetectionFinished ( ) ) );
 
 	}
 
@@ -35,8 +50,12 @@ namespace NiS {
 
 		std::cout << "onAddFisleButtonPushed" << std::endl;
 
-		QString file_name = QFileDialog::getOpenFileName ( this , "Add File" , "." , "*.dat" );
-		ui_.ListWidget_FileList->addItem ( file_name );
+		QString file_name = QFileDialog::getOpenFileName ( this , "Add File" , "." , "*.dat *.seq" );
+
+		if ( !file_name.isEmpty ( ) ) {
+			AddFile ( QFileInfo ( file_name ) );
+			UpdateFrameSources ( );
+		}
 
 	}
 
@@ -50,18 +69,55 @@ namespace NiS {
 
 		QStringList filters;
 		filters.push_back ( QString ( "*.dat" ) );
+		filters.push_back ( QString ( "*.seq" ) );
 		QFileInfoList file_info_list = dir.entryInfoList ( filters );
 
 		for ( int i = 0 ; i < file_info_list.size ( ) ; ++i ) {
+			AddFile ( file_info_list[ i ] );
+		}
+
+		UpdateFrameSources ( );
+	}
 
-			auto & file_info = file_info_list[ i ];
+	void FrameViewer::AddFile ( const QFileInfo & file_info ) {
+
+		// Items keep the file path in Qt::UserRole and the frame number in the file in Qt::UserRole + 1.
+		auto add_item = [ this , &file_info ] ( const QString & label , int frame ) {
 
 			QListWidgetItem * item = new QListWidgetItem ( QString ( "%1 : (%2)" )
-					                                               .arg ( i + 1 )
-					                                               .arg ( file_info.baseName ( ) ) ,
+					                                               .arg ( ui_.ListWidget_FileList->count ( ) + 1 )
+					                                               .arg ( label ) ,
 			                                               ui_.ListWidget_FileList );
 			item->setData ( Qt::UserRole , file_info.absoluteFilePath ( ) );
+			item->setData ( Qt::UserRole + 1 , frame );
 			ui_.ListWidget_FileList->addItem ( item );
+		};
+
+		if ( IsSequenceFile ( file_info.absoluteFilePath ( ).toStdString ( ) ) ) {
+
+			const SequenceFileReader reader ( file_info.absoluteFilePath ( ).toStdString ( ) );
+
+			for ( auto frame = 0 ; frame < reader.GetFrameCount ( ) ; ++frame ) {
+				add_item ( QFileInfo ( QString::fromStdString ( reader.GetFrameName ( frame ) ) ).baseName ( ) , frame );
+			}
+
+		} else {
+
+			// Multi frame .dat files get an item per frame, only the headers are probed. The layout is kept so that
+			// their frames are read straight from their offsets.
+			auto          info = std::make_shared < RawDataFileInfo > ( );
+			std::ifstream in ( file_info.absoluteFilePath ( ).toStdString ( ) , std::ios::binary );
+
+			if ( in and ProbeRawDataFrames ( in , * info ) and info->frames.size ( ) > 1 ) {
+
+				file_infos_[ file_info.absoluteFilePath ( ) ] = info;
+
+				for ( auto frame = 0 ; frame < static_cast < int > ( info->frames.size ( ) ) ; ++frame ) {
+					add_item ( QString ( "%1 #%2" ).arg ( file_info.baseName ( ) ).arg ( frame ) , frame );
+				}
+			} else {
+				add_item ( file_info.baseName ( ) , 0 );
+			}
 		}
 	}
 
@@ -69,49 +125,123 @@ namespace NiS {
 
 		std::cout << "onCLearButtonPushed" << std::endl;
 
+		detection_watcher_.cancel ( );
+
 		ui_.ListWidget_FileList->clear ( );
+		file_infos_.clear ( );
+
+		UpdateFrameSources ( );
+	}
+
+	void FrameViewer::UpdateFrameSources ( ) {
+
+		frame_sources_.clear ( );
+
+		for ( auto row = 0 ; row < ui_.ListWidget_FileList->count ( ) ; ++row ) {
+
+			const QListWidgetItem * item = ui_.ListWidget_FileList->item ( row );
+			const QString file_name = item->data ( Qt::UserRole ).toString ( );
+
+			frame_sources_.push_back ( FrameSource { file_name , item->data ( Qt::UserRole + 1 ).toInt ( ) ,
+			                                         file_infos_.value ( file_name ) } );
+		}
+
+		// The loader runs on the prefetcher's threads, it gets a copy of the list of its own.
+		const QList < FrameSource > sources = frame_sources_;
+
+		prefetcher_.SetLoader ( [ sources ] ( int row ) { return LoadDisplayFrame ( sources[ row ] ); } );
+
+		// Loads that were pending have been dropped with the cache
+		loading_row_ = -1;
+		onFileListCurrentItemChanged ( ui_.ListWidget_FileList->currentRow ( ) );
 	}
 
 	void FrameViewer::onFileListCurrentItemChanged ( int row ) {
 
-		if ( row < 0 ) {
+		if ( row < 0 or row >= frame_sources_.size ( ) ) {
+			return;
+		}
+
+		std::cout << frame_sources_[ row ].file_name.toStdString ( ) << std::endl;
+
+		QFuture < DisplayFrame > future = prefetcher_.Request ( row );
+		prefetcher_.Prefetch ( row , kPrefetchRadius , frame_sources_.size ( ) );
+
+		if ( future.isFinished ( ) ) {
+
+			loading_row_ = -1;
+
+			if ( future.resultCount ( ) > 0 ) {
+				ShowFrame ( future.result ( ) );
+			}
+
+		} else {
+
+			// Shown by onFrameLoaded, unless another row is selected in the meantime
+			loading_row_ = row;
+			frame_watcher_.setFuture ( future );
+		}
+	}
+
+	void FrameViewer::onFrameLoaded ( ) {
+
+		if ( loading_row_ < 0 or loading_row_ != ui_.ListWidget_FileList->currentRow ( ) ) {
 			return;
 		}
 
-		std::cout << ui_.ListWidget_FileList->item ( row )->data ( Qt::UserRole ).toString ( ).toStdString ( ) << std::endl;
+		loading_row_ = -1;
 
-		NiS::RawDataFrame frame = NiS::ImageHandler2::ReadFrame ( ui_.ListWidget_FileList->item ( row )->data ( Qt::UserRole ).toString ( ) );
+		if ( frame_watcher_.future ( ).resultCount ( ) > 0 ) {
+			ShowFrame ( frame_watcher_.result ( ) );
+		}
+	}
 
-		color_image_ = frame.color_image;
-		depth_image_ = frame.depth_image;
+	void FrameViewer::ShowFrame ( const DisplayFrame & frame ) {
 
-		onDetectMarkerButtonPushed ( );
+		color_image_     = frame.color_image;
+		depth_image_rgb_ = frame.depth_image_rgb;
+		has_marker_      = frame.has_marker;
 
-//		UpdateDisplayImage ( );
+		UpdateDisplayImage ( );
 	}
 
-	void FrameViewer::onDetectMarkerButtonPushed ( ) {
+	RawDataFrame FrameViewer::ReadFrame ( const FrameSource & source ) {
+
+		return source.info ? NiS::ImageHandler2::ReadFrame ( source.file_name , * source.info , source.frame )
+		                   : NiS::ImageHandler2::ReadFrame ( source.file_name , source.frame );
+	}
+
+	FrameViewer::DisplayFrame FrameViewer::LoadDisplayFrame ( const FrameSource & source ) {
 
 		using namespace aruco;
 		using namespace cv;
 
-		if ( not color_image_.empty ( ) and not depth_image_.empty ( ) ) {
+		const NiS::RawDataFrame frame = ReadFrame ( source );
+
+		const DepthImage depth_image = frame.depth_image;
+
+		DisplayFrame display_frame;
+
+		if ( not frame.color_image.empty ( ) and not depth_image.empty ( ) ) {
+
+			// The markers are drawn on a copy, the frame may refer to a mapped file.
+			display_frame.color_image = frame.color_image.clone ( );
 
 			cv::Mat depth_image_rgb;
-			depth_image_.convertTo ( depth_image_rgb , CV_8UC1 , 255.0f / 10000.0f );
+			depth_image.convertTo ( depth_image_rgb , CV_8UC1 , 255.0f / 10000.0f );
 			cv::cvtColor ( depth_image_rgb , depth_image_rgb , CV_GRAY2RGB );
 
-			depth_image_rgb_ = depth_image_rgb;
+			display_frame.depth_image_rgb = depth_image_rgb;
 
 			MarkerDetector    marker_detector;
 			vector < Marker > markers;
 
-			marker_detector.detect ( color_image_ , markers );
+			marker_detector.detect ( display_frame.color_image , markers );
 
-			has_marker_ = ( not markers.empty ( ) );
+			display_frame.has_marker = ( not markers.empty ( ) );
 
 			for ( auto const & marker : markers ) {
-				marker.draw ( color_image_ , Scalar ( 0 , 0 , 255 ) , 2 );
+				marker.draw ( display_frame.color_image , Scalar ( 0 , 0 , 255 ) , 2 );
 
 				bool valid_marker = true;
 				for ( const auto & vertex : marker ) {
@@ -119,9 +249,7 @@ namespace NiS {
 					const auto row = cvRound ( vertex.y );
 					const auto col = cvRound ( vertex.x );
 
-					std::cout << depth_image_.at < ushort > ( row , col ) << std::endl;
-
-					if ( depth_image_.at < ushort > ( row , col ) == 0 ) {
+					if ( depth_image.at < ushort > ( row , col ) == 0 ) {
 
 						std::cout << marker.id << " : [" << vertex.y << ", " << vertex.x << "], depth == 0\n";
 
@@ -130,12 +258,28 @@ namespace NiS {
 				}
 
 				if ( valid_marker ) {
-					marker.draw ( depth_image_rgb_ , Scalar ( 0 , 0 , 255 ) , 2 );
+					marker.draw ( display_frame.depth_image_rgb , Scalar ( 0 , 0 , 255 ) , 2 );
 				}
 			}
+		}
+
+		return display_frame;
+	}
+
+	bool FrameViewer::HasMarker ( const FrameSource & source ) {
+
+		const NiS::RawDataFrame frame = ReadFrame ( source );
 
-			UpdateDisplayImage ( );
+		if ( frame.color_image.empty ( ) or frame.depth_image.empty ( ) ) {
+			return false;
 		}
+
+		aruco::MarkerDetector         marker_detector;
+		std::vector < aruco::Marker > markers;
+
+		marker_detector.detect ( frame.color_image , markers );
+
+		return not markers.empty ( );
 	}
 
 	void FrameViewer::resizeEvent ( QResizeEvent * e ) {
@@ -182,16 +326,30 @@ namespace NiS {
 
 	void FrameViewer::onTryDetection ( ) {
 
-		for ( auto i = 0 ; i < ui_.ListWidget_FileList->count ( ) ; ++i ) {
+		if ( detection_watcher_.isRunning ( ) or frame_sources_.empty ( ) ) {
+			return;
+		}
 
-			ui_.ListWidget_FileList->setCurrentRow ( i );
-			onFileListCurrentItemChanged ( i );
+		// Every frame is read and searched in the background, the rows are marked as the results come in.
+		ui_.PushButton_TryDetection->setEnabled ( false );
 
-			if ( has_marker_ ) {
-				ui_.ListWidget_FileList->currentItem ( )->setBackgroundColor ( QColor::fromRgb ( qRgb ( 100 , 100 , 100 ) ) );
-				ui_.ListWidget_FileList->currentItem ( )->setTextColor ( QColor::fromRgb ( qRgb ( 255 , 100 , 100 ) ) );
-			}
+		detection_watcher_.setFuture ( QtConcurrent::mapped ( frame_sources_ , & FrameViewer::HasMarker ) );
+	}
+
+	void FrameViewer::onDetectionResultReady ( int row ) {
+
+		if ( row >= ui_.ListWidget_FileList->count ( ) or not detection_watcher_.resultAt ( row ) ) {
+			return;
 		}
 
+		QListWidgetItem * item = ui_.ListWidget_FileList->item ( row );
+
+		item->setBackgroundColor ( QColor::fromRgb ( qRgb ( 100 , 100 , 100 ) ) );
+		item->setTextColor ( QColor::fromRgb ( qRgb ( 255 , 100 , 100 ) ) );
+	}
+
+	void FrameViewer::onDetectionFinished ( ) {
+
+		ui_.PushButton_TryDetection->setEnabled ( true );
 	}
-}
\ No newline at end of file
+}
@@ -4,6 +4,7 @@
 
 #include "BasicViewer/KeyFrameGL.h"
 
+#include <algorithm>
 #include <limits>
 
 namespace NiS {
@@ -11,10 +12,12 @@ namespace NiS {
 
 	KeyFrameGL::KeyFrameGL ( QOpenGLFunctions_4_1_Core * GL ,
 	                         const KeyFrame & keyframe ,
-	                         const int & point_cloud_density_step ) :
+	                         const int & point_cloud_density_step ,
+	                         const KeyFrameLoader & loader ) :
 			PrimitiveGL ( GL ) ,
 			keyframe_ ( keyframe ) ,
-			point_cloud_density_step_ ( point_cloud_density_step ) {
+			point_cloud_density_step_ ( point_cloud_density_step ) ,
+			loader_ ( loader ) {
 	}
 
 	void KeyFrameGL::Render ( ) {
@@ -34,23 +37,45 @@ namespace NiS {
 
 	void KeyFrameGL::SetupData ( ) {
 
+		// Frames released in streaming mode are shown from a restored copy, released again once uploaded
+		KeyFrame         restored;
+		const KeyFrame * keyframe = & keyframe_;
+
+		if ( !keyframe_.HasImages ( ) and loader_ ) {
+
+			restored = keyframe_;
+			loader_ ( restored );
+			keyframe = & restored;
+		}
+
 		// use a local buffer to send data to GPU and then immediately destroy it
-		const ColorImage & color_image = keyframe_.GetColorImage ( );
-		const PointImage & point_image = keyframe_.GetPointImage ( );
+		const ColorImage & color_image = keyframe->GetColorImage ( );
+		const DepthImage & depth_image = keyframe->GetDepthImage ( );
+
+		const auto rows = std::min ( color_image.rows , depth_image.rows );
+		const auto cols = std::min ( color_image.cols , depth_image.cols );
+
+		// Every point is shown : whole rows are decoded from the compact point image,
+		// otherwise only the points shown are converted.
+		const auto compact_point_image = point_cloud_density_step_ == 1 ? keyframe->GetCompactPointImage ( ) : nullptr;
 
-		const auto rows = color_image.rows;
-		const auto cols = point_image.cols;
+		std::vector < cv::Vec3f > points ( static_cast < size_t > ( std::max ( cols , 0 ) ) );
 
 		data_.clear ( );
 
 		for ( auto row = 0 ; row < rows ; row += point_cloud_density_step_ ) {
+
+			if ( compact_point_image ) {
+				compact_point_image->DecodeRow ( row , points.data ( ) );
+			}
+
 			for ( auto col = 0 ; col < cols ; col += point_cloud_density_step_ ) {
 
 				VertexGL vertex;
 
-				vertex.position = glm::vec3 ( point_image.at < cv::Vec3f > ( row , col )[ 0 ] ,
-				                              point_image.at < cv::Vec3f > ( row , col )[ 1 ] ,
-				                              point_image.at < cv::Vec3f > ( row , col )[ 2 ] );
+				const WorldPoint point = compact_point_image ? WorldPoint ( points[ col ] ) : keyframe->GetPoint ( row , col );
+
+				vertex.position = glm::vec3 ( point.x , point.y , point.z );
 
 				vertex.color = glm::vec3 ( color_image.at < cv::Vec3b > ( row , col )[ 0 ] / 255.0f ,
 				                           color_image.at < cv::Vec3b > ( row , col )[ 1 ] / 255.0f ,
@@ -62,7 +87,12 @@ namespace NiS {
 			}
 		}
 
-		assert ( !data_.empty ( ) );
+		// Released frames without a loader have no point cloud to show
+		assert ( !keyframe->HasImages ( ) or !data_.empty ( ) );
+
+		if ( keyframe == & restored ) {
+			restored.ReleaseImages ( );
+		}
 
 		GL->glGenVertexArrays ( 1 , & vao_id_ );
 		GL->glGenBuffers ( 1 , & vbo_id_ );
@@ -0,0 +1,294 @@
+#include "Core/DepthCodec.h"
+#include "Core/FramePool.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace NiS {
+
+	namespace {
+
+		// Largest decoded image, a broken header does not make a huge allocation
+		const std::uint64_t kMaxDecodedPixels = std::uint64_t ( 1 ) << 26;
+
+		// (value << 1) ^ (value >> 15) of the signed residual, unsigned : shifting a negative value is undefined
+		inline std::uint16_t ZigZag ( std::uint16_t residual ) {
+
+			const std::uint32_t sign = 0u - static_cast < std::uint32_t > ( residual >> 15 );
+			return static_cast < std::uint16_t > ( ( static_cast < std::uint32_t > ( residual ) << 1 ) ^ sign );
+		}
+
+		inline int BitWidth ( std::uint16_t value ) {
+
+			int width = 0;
+			while ( value ) {
+				++width;
+				value >>= 1;
+			}
+			return width;
+		}
+
+		void EncodeRow ( const ushort * row , const ushort * upper_row , int cols , std::vector < uchar > & out ) {
+
+			std::uint16_t residuals[kDepthCodecBlockSize];
+
+			ushort previous = upper_row ? upper_row[ 0 ] : 0;
+
+			for ( auto begin = 0 ; begin < cols ; begin += kDepthCodecBlockSize ) {
+
+				const int count = std::min ( kDepthCodecBlockSize , cols - begin );
+
+				std::uint16_t max_residual = 0;
+
+				for ( auto i = 0 ; i < kDepthCodecBlockSize ; ++i ) {
+
+					if ( i < count ) {
+						residuals[ i ] = ZigZag ( static_cast < std::uint16_t > ( row[ begin + i ] - previous ) );
+						previous       = row[ begin + i ];
+					} else {
+						residuals[ i ] = 0;
+					}
+
+					max_residual |= residuals[ i ];
+				}
+
+				const int width = BitWidth ( max_residual );
+
+				out.push_back ( static_cast < uchar > ( width ) );
+
+				// 16 residuals of width bits make exactly 2 * width bytes
+				std::uint64_t buffer = 0;
+				int           filled = 0;
+
+				for ( auto i = 0 ; i < kDepthCodecBlockSize ; ++i ) {
+
+					buffer |= static_cast < std::uint64_t > ( residuals[ i ] ) << filled;
+					filled += width;
+
+					while ( filled >= 8 ) {
+						out.push_back ( static_cast < uchar > ( buffer & 0xff ) );
+						buffer >>= 8;
+						filled -= 8;
+					}
+				}
+			}
+		}
+
+		template < int Width >
+		inline void UnpackBlock ( const uchar * payload , std::uint16_t * residuals ) {
+
+			// 16 residuals of Width bits are read as 2 x 8 residuals of Width bytes, which fit in 64 + 64 bits
+			const std::uint64_t mask = ( std::uint64_t ( 1 ) << Width ) - 1;
+
+			for ( auto half = 0 ; half < 2 ; ++half ) {
+
+				std::uint64_t low = 0 , high = 0;
+				std::memcpy ( & low , payload + half * Width , std::min ( Width , 8 ) );
+				if ( Width > 8 ) {
+					std::memcpy ( & high , payload + half * Width + 8 , Width - 8 );
+				}
+
+				for ( auto i = 0 ; i < 8 ; ++i ) {
+
+					const int bit = i * Width;
+
+					std::uint64_t value = bit < 64 ? ( low >> bit ) : 0;
+					if ( bit + Width > 64 ) {
+						value |= bit < 64 ? ( high << ( 64 - bit ) ) : ( high >> ( bit - 64 ) );
+					}
+
+					residuals[ half * 8 + i ] = static_cast < std::uint16_t > ( value & mask );
+				}
+			}
+		}
+
+		// Unpacks the zigzag coded residuals of a block.
+		inline void UnpackBlock ( const uchar * payload , int width , std::uint16_t * residuals ) {
+
+			switch ( width ) {
+				case 0:
+					std::memset ( residuals , 0 , sizeof ( std::uint16_t ) * kDepthCodecBlockSize );
+					break;
+				case 1: UnpackBlock < 1 > ( payload , residuals ); break;
+				case 2: UnpackBlock < 2 > ( payload , residuals ); break;
+				case 3: UnpackBlock < 3 > ( payload , residuals ); break;
+				case 4: UnpackBlock < 4 > ( payload , residuals ); break;
+				case 5: UnpackBlock < 5 > ( payload , residuals ); break;
+				case 6: UnpackBlock < 6 > ( payload , residuals ); break;
+				case 7: UnpackBlock < 7 > ( payload , residuals ); break;
+				case 8: UnpackBlock < 8 > ( payload , residuals ); break;
+				case 9: UnpackBlock < 9 > ( payload , residuals ); break;
+				case 10: UnpackBlock < 10 > ( payload , residuals ); break;
+				case 11: UnpackBlock < 11 > ( payload , residuals ); break;
+				case 12: UnpackBlock < 12 > ( payload , residuals ); break;
+				case 13: UnpackBlock < 13 > ( payload , residuals ); break;
+				case 14: UnpackBlock < 14 > ( payload , residuals ); break;
+				case 15: UnpackBlock < 15 > ( payload , residuals ); break;
+				default:
+					std::memcpy ( residuals , payload , sizeof ( std::uint16_t ) * kDepthCodecBlockSize );
+					break;
+			}
+		}
+
+		// Zigzag decodes the residuals and turns them into depth values by a running sum.
+		inline ushort ReconstructBlock ( const std::uint16_t * residuals , ushort previous , ushort * values ) {
+
+#if defined(__SSE2__)
+			const __m128i one = _mm_set1_epi16 ( 1 );
+
+			__m128i carry = _mm_set1_epi16 ( static_cast < short > ( previous ) );
+
+			for ( auto half = 0 ; half < kDepthCodecBlockSize ; half += 8 ) {
+
+				__m128i v = _mm_loadu_si128 ( reinterpret_cast < const __m128i * > ( residuals + half ) );
+
+				// (v >> 1) ^ -(v & 1)
+				v = _mm_xor_si128 ( _mm_srli_epi16 ( v , 1 ) , _mm_sub_epi16 ( _mm_setzero_si128 ( ) , _mm_and_si128 ( v , one ) ) );
+
+				// Inclusive prefix sum over the 8 lanes
+				v = _mm_add_epi16 ( v , _mm_slli_si128 ( v , 2 ) );
+				v = _mm_add_epi16 ( v , _mm_slli_si128 ( v , 4 ) );
+				v = _mm_add_epi16 ( v , _mm_slli_si128 ( v , 8 ) );
+				v = _mm_add_epi16 ( v , carry );
+
+				_mm_storeu_si128 ( reinterpret_cast < __m128i * > ( values + half ) , v );
+
+				carry = _mm_shufflehi_epi16 ( v , _MM_SHUFFLE ( 3 , 3 , 3 , 3 ) );
+				carry = _mm_unpackhi_epi64 ( carry , carry );
+			}
+
+			return values[ kDepthCodecBlockSize - 1 ];
+#else
+			for ( auto i = 0 ; i < kDepthCodecBlockSize ; ++i ) {
+
+				const std::uint16_t zigzag = residuals[ i ];
+				const std::uint16_t delta  = static_cast < std::uint16_t > ( ( zigzag >> 1 ) ^ ( 0 - ( zigzag & 1 ) ) );
+
+				previous = static_cast < ushort > ( previous + delta );
+				values[ i ] = previous;
+			}
+
+			return previous;
+#endif
+		}
+
+		bool DecodeRow ( const uchar * & data , const uchar * end , const ushort * upper_row , int cols , ushort * row ) {
+
+			std::uint16_t residuals[kDepthCodecBlockSize];
+			ushort        values[kDepthCodecBlockSize];
+
+			ushort previous = upper_row ? upper_row[ 0 ] : 0;
+
+			for ( auto begin = 0 ; begin < cols ; begin += kDepthCodecBlockSize ) {
+
+				if ( data >= end ) {
+					return false;
+				}
+
+				const int width = * data++;
+
+				if ( width > 16 or data + 2 * width > end ) {
+					return false;
+				}
+
+				UnpackBlock ( data , width , residuals );
+				data += 2 * width;
+
+				const int count = std::min ( kDepthCodecBlockSize , cols - begin );
+
+				if ( count == kDepthCodecBlockSize ) {
+					previous = ReconstructBlock ( residuals , previous , row + begin );
+				} else {
+					ReconstructBlock ( residuals , previous , values );
+					std::memcpy ( row + begin , values , sizeof ( ushort ) * count );
+				}
+			}
+
+			return true;
+		}
+
+	}
+
+	std::vector < uchar > EncodeDepthImage ( const cv::Mat_ < ushort > & depth_image ) {
+
+		const std::int32_t rows = depth_image.rows;
+		const std::int32_t cols = depth_image.cols;
+
+		std::vector < uchar > out ( kDepthCodecHeaderSize );
+		out.reserve ( kDepthCodecHeaderSize + depth_image.total ( ) * sizeof ( ushort ) / 2 );
+
+		for ( auto row = 0 ; row < rows ; ++row ) {
+			EncodeRow ( depth_image[ row ] , row > 0 ? depth_image[ row - 1 ] : nullptr , cols , out );
+		}
+
+		const std::uint32_t payload_size = static_cast < std::uint32_t > ( out.size ( ) - kDepthCodecHeaderSize );
+
+		std::memcpy ( out.data ( ) , & rows , sizeof ( rows ) );
+		std::memcpy ( out.data ( ) + sizeof ( rows ) , & cols , sizeof ( cols ) );
+		std::memcpy ( out.data ( ) + sizeof ( rows ) + sizeof ( cols ) , & payload_size , sizeof ( payload_size ) );
+
+		return out;
+	}
+
+	std::size_t GetEncodedDepthImageSize ( const uchar * data , std::size_t size ) {
+
+		if ( size < kDepthCodecHeaderSize ) {
+			return 0;
+		}
+
+		std::uint32_t payload_size;
+		std::memcpy ( & payload_size , data + sizeof ( std::int32_t ) * 2 , sizeof ( payload_size ) );
+
+		return kDepthCodecHeaderSize + payload_size;
+	}
+
+	bool DecodeDepthImage ( const uchar * data , std::size_t size , cv::Mat_ < ushort > & depth_image ) {
+
+		const std::size_t encoded_size = GetEncodedDepthImageSize ( data , size );
+
+		if ( encoded_size == 0 or encoded_size > size ) {
+			return false;
+		}
+
+		std::int32_t rows , cols;
+		std::memcpy ( & rows , data , sizeof ( rows ) );
+		std::memcpy ( & cols , data + sizeof ( rows ) , sizeof ( cols ) );
+
+		if ( rows < 0 or cols < 0 ) {
+			return false;
+		}
+
+		// Every block of 16 pixels takes one byte of payload at least
+		const std::uint64_t pixels = static_cast < std::uint64_t > ( rows ) * static_cast < std::uint64_t > ( cols );
+		const std::uint64_t blocks = static_cast < std::uint64_t > ( rows ) *
+		                             ( ( static_cast < std::uint64_t > ( cols ) + kDepthCodecBlockSize - 1 ) / kDepthCodecBlockSize );
+
+		if ( pixels > kMaxDecodedPixels or blocks > encoded_size - kDepthCodecHeaderSize ) {
+			return false;
+		}
+
+		// Decoded on every access of encoded recordings, the buffers are recycled
+		if ( !depth_image.allocator ) {
+			depth_image.allocator = & FramePool::Instance ( );
+		}
+
+		depth_image.create ( rows , cols );
+
+		const uchar * payload = data + kDepthCodecHeaderSize;
+		const uchar * end     = data + encoded_size;
+
+		for ( auto row = 0 ; row < rows ; ++row ) {
+			if ( !DecodeRow ( payload , end , row > 0 ? depth_image[ row - 1 ] : nullptr , cols , depth_image[ row ] ) ) {
+				depth_image.release ( );
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+}
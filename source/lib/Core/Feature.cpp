@@ -3,59 +3,29 @@
 //
 
 #include "Core/Feature.h"
+#include "Core/FeatureExtractor.h"
+
+#include <iostream>
 
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 
 namespace NiS {
 
-    template<>
-    void Feature::Detect<cv::SiftFeatureDetector, cv::SiftDescriptorExtractor>(const cv::Mat_<uchar> &image,
-                                                                               KeyPoints *key_points,
-                                                                               Descriptors *descriptors) {
-
-        if (!image.empty()) {
-
-            // detecting keypoints
-            cv::SiftFeatureDetector detector;
-            detector.detect(image, *key_points);
-
-            // computing descriptors
-            cv::SiftDescriptorExtractor extractor;
-            extractor.compute(image, *key_points, *descriptors);
-        }
-    };
-
-
     Feature::Feature()
             : type_(kTypeUnknown) { }
 
     Feature::Feature(const cv::Mat_<uchar> &image, Type type)
             : type_(type) {
 
-        switch (type_) {
-
-            case kTypeORB:
-                Detect<cv::OrbFeatureDetector, cv::OrbDescriptorExtractor>(image, &key_points_, &descriptors_);
-                break;
-
-            case kTypeFREAK:
-                Detect<cv::SurfFeatureDetector, cv::FREAK>(image, &key_points_, &descriptors_);
-                break;
-
-            case kTypeSIFT:
-                Detect<cv::SiftFeatureDetector, cv::SiftDescriptorExtractor>(image, &key_points_, &descriptors_);
-                break;
-
-            case kTypeSURF:
-                Detect<cv::SurfFeatureDetector, cv::SurfDescriptorExtractor>(image, &key_points_, &descriptors_);
-                break;
-
-            default:
-                break;
-        }
+        // The detectors and extractors of the calling thread
+        *this = FeatureExtractor(type).Extract(image);
     }
 
+    Feature::Feature(Type type, const KeyPoints &key_points, const Descriptors &descriptors,
+                     const std::shared_ptr<void> &storage)
+            : type_(type), key_points_(key_points), descriptors_(descriptors), storage_(storage) { }
+
     Feature::~Feature() { }
 
     bool SaveFeature(const std::string &file_name, const Feature &feature) {
@@ -70,9 +40,14 @@ namespace NiS {
             f.push(bio::gzip_compressor());
             f.push(out);
 
-            boost::archive::binary_oarchive ar(out);
-            ar << feature;
-            return true;
+            // The archive has to be done before the stream closes the gzip chain
+            {
+                boost::archive::binary_oarchive ar(f);
+                ar << feature;
+            }
+
+            f.reset();
+            return static_cast<bool>(out);
         }
         return false;
     }
@@ -85,13 +60,26 @@ namespace NiS {
 
             namespace bio = boost::iostreams;
 
-            bio::filtering_istream f;
-            f.push(bio::gzip_decompressor());
-            f.push(in);
+            // Files of former versions were written without compression
+            const bool compressed = in.peek() == 0x1f;
+
+            try {
+
+                bio::filtering_istream f;
+                if (compressed) {
+                    f.push(bio::gzip_decompressor());
+                }
+                f.push(in);
+
+                boost::archive::binary_iarchive ar(f);
+                ar >> feature;
+                return true;
+            }
+            catch (const std::exception &e) {
 
-            boost::archive::binary_iarchive ar(in);
-            ar >> feature;
-            return true;
+                std::cout << "Loading feature failed : " << file_name << " (" << e.what() << ")" << std::endl;
+                return false;
+            }
         }
 
         return false;
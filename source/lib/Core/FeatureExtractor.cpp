@@ -0,0 +1,292 @@
+#include "Core/FeatureExtractor.h"
+#include "Core/FeatureStore.h"
+#include "Core/Utility.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+namespace NiS {
+
+	namespace {
+
+		const int kFeatureTypeCount = Feature::kTypeSURF + 1;
+
+		struct ExtractionEngine
+		{
+			cv::Ptr < cv::Feature2D >           feature2d;     // detector and extractor, or
+			cv::Ptr < cv::FeatureDetector >     detector;
+			cv::Ptr < cv::DescriptorExtractor > extractor;
+			Feature::KeyPoints                  key_points;    // scratch, keep their capacity
+			std::vector < Feature::KeyPoints >  cells;
+			Feature::KeyPoints                  rank;
+		};
+
+		bool IsStronger ( const cv::KeyPoint & a , const cv::KeyPoint & b ) { return a.response > b.response; }
+
+		// Depth at the key point pixel and no missing depth nor depth step around it
+		bool HasValidDepth ( const cv::Mat_ < ushort > & depth_image , const cv::Point2f & pt , int radius , float max_step ) {
+
+			const int row = cvRound ( pt.y );
+			const int col = cvRound ( pt.x );
+
+			if ( row < 0 or col < 0 or row >= depth_image.rows or col >= depth_image.cols or depth_image ( row , col ) == 0 ) {
+				return false;
+			}
+
+			const int   depth = depth_image ( row , col );
+			const float limit = max_step * depth;
+
+			for ( auto r = std::max ( row - radius , 0 ) ; r <= std::min ( row + radius , depth_image.rows - 1 ) ; ++r ) {
+
+				const ushort * values = depth_image[ r ];
+
+				for ( auto c = std::max ( col - radius , 0 ) ; c <= std::min ( col + radius , depth_image.cols - 1 ) ; ++c ) {
+					if ( values[ c ] == 0 or std::abs ( values[ c ] - depth ) > limit ) {
+						return false;
+					}
+				}
+			}
+
+			return true;
+		}
+
+		void FilterKeyPointsByDepth ( const DetectionParameters & parameters , const cv::Mat_ < ushort > & depth_image ,
+		                              Feature::KeyPoints & key_points ) {
+
+			key_points.erase ( std::remove_if ( key_points.begin ( ) , key_points.end ( ) , [ & ] ( const cv::KeyPoint & key_point ) {
+
+				return !HasValidDepth ( depth_image , key_point.pt , parameters.depth_filter_radius , parameters.max_depth_step );
+			} ) , key_points.end ( ) );
+		}
+
+		// Keeps the key points of DetectionParameters, see there
+		void BucketKeyPoints ( const DetectionParameters & parameters , int rows , int cols , ExtractionEngine & engine ) {
+
+			auto & key_points = engine.key_points;
+			auto & cells      = engine.cells;
+			auto & rank       = engine.rank;
+
+			const std::size_t budget = static_cast < std::size_t > ( parameters.max_key_points );
+			const std::size_t kept   = static_cast < std::size_t > ( parameters.max_per_cell );
+
+			cells.resize ( static_cast < std::size_t > ( parameters.grid_cols * parameters.grid_rows ) );
+
+			for ( auto & cell : cells ) {
+				cell.clear ( );
+			}
+
+			for ( const auto & key_point : key_points ) {
+
+				const int cell_col = LimitRange ( static_cast < int > ( key_point.pt.x * parameters.grid_cols / cols ) , 0 , parameters.grid_cols - 1 );
+				const int cell_row = LimitRange ( static_cast < int > ( key_point.pt.y * parameters.grid_rows / rows ) , 0 , parameters.grid_rows - 1 );
+
+				cells[ cell_row * parameters.grid_cols + cell_col ].push_back ( key_point );
+			}
+
+			for ( auto & cell : cells ) {
+
+				if ( cell.size ( ) > kept ) {
+					std::partial_sort ( cell.begin ( ) , cell.begin ( ) + kept , cell.end ( ) , IsStronger );
+					cell.resize ( kept );
+				} else {
+					std::sort ( cell.begin ( ) , cell.end ( ) , IsStronger );
+				}
+			}
+
+			key_points.clear ( );
+
+			for ( std::size_t r = 0 ; r < kept and key_points.size ( ) < budget ; ++r ) {
+
+				rank.clear ( );
+
+				for ( const auto & cell : cells ) {
+					if ( r < cell.size ( ) ) {
+						rank.push_back ( cell[ r ] );
+					}
+				}
+
+				if ( rank.empty ( ) ) {
+					break;
+				}
+
+				// The strongest of the last rank fill the budget
+				const std::size_t count = std::min ( rank.size ( ) , budget - key_points.size ( ) );
+
+				if ( count < rank.size ( ) ) {
+					std::partial_sort ( rank.begin ( ) , rank.begin ( ) + count , rank.end ( ) , IsStronger );
+				}
+
+				key_points.insert ( key_points.end ( ) , rank.begin ( ) , rank.begin ( ) + count );
+			}
+		}
+
+		// Same configurations as the detectors and extractors constructed by default
+		std::unique_ptr < ExtractionEngine > CreateEngine ( Feature::Type type ) {
+
+			std::unique_ptr < ExtractionEngine > engine ( new ExtractionEngine );
+
+			switch ( type ) {
+
+				case Feature::kTypeORB:
+					engine->feature2d = new cv::ORB ( );
+					break;
+
+				case Feature::kTypeFREAK:
+					engine->detector  = new cv::SURF ( );
+					engine->extractor = new cv::FREAK ( );
+					break;
+
+				case Feature::kTypeSIFT:
+					engine->feature2d = new cv::SIFT ( );
+					break;
+
+				case Feature::kTypeSURF:
+					engine->feature2d = new cv::SURF ( );
+					break;
+
+				default:
+					return nullptr;
+			}
+
+			return engine;
+		}
+
+		// Engine of the calling thread, nullptr for unknown types
+		ExtractionEngine * GetEngine ( Feature::Type type ) {
+
+			thread_local std::unique_ptr < ExtractionEngine > engines[ kFeatureTypeCount ];
+
+			if ( type < 0 or type >= kFeatureTypeCount ) {
+				return nullptr;
+			}
+
+			auto & engine = engines[ type ];
+
+			if ( !engine ) {
+				engine = CreateEngine ( type );
+			}
+
+			return engine.get ( );
+		}
+	}
+
+	std::uint64_t DetectionParameters::Hash ( ) const {
+
+		if ( !IsBucketed ( ) and !IsDepthFiltered ( ) ) {
+			return kDefaultFeatureParameters;
+		}
+
+		// FNV-1a of the parameters in use, the high byte is left to ScaledFeatureParameters
+		std::vector < std::uint32_t > values;
+
+		if ( IsBucketed ( ) ) {
+			values.insert ( values.end ( ) , { 1u , static_cast < std::uint32_t > ( grid_cols ) , static_cast < std::uint32_t > ( grid_rows ) ,
+			                                   static_cast < std::uint32_t > ( max_per_cell ) , static_cast < std::uint32_t > ( max_key_points ) } );
+		}
+
+		if ( IsDepthFiltered ( ) ) {
+
+			std::uint32_t step;
+			std::memcpy ( & step , & max_depth_step , sizeof ( step ) );
+
+			values.insert ( values.end ( ) , { 2u , static_cast < std::uint32_t > ( depth_filter_radius ) , step } );
+		}
+
+		std::uint64_t hash = 14695981039346656037ull;
+
+		for ( auto value : values ) {
+			for ( auto byte = 0 ; byte < 4 ; ++byte ) {
+				hash ^= ( value >> ( byte * 8 ) ) & 0xFF;
+				hash *= 1099511628211ull;
+			}
+		}
+
+		hash &= 0x00FFFFFFFFFFFFFFull;
+
+		return hash == kDefaultFeatureParameters ? 1 : hash;
+	}
+
+	QString DetectionParameters::Output ( ) const {
+
+		QString res;
+		res.append ( QString ( "Parameters of Key Point Detection :\n" ) );
+		res.append ( QString ( "----------------------------------\n" ) );
+
+		if ( IsBucketed ( ) ) {
+			res.append ( QString ( "Grid                       : %1 x %2\n" ).arg ( grid_cols ).arg ( grid_rows ) );
+			res.append ( QString ( "Key points per cell        : %1\n" ).arg ( QString::number ( max_per_cell ) ) );
+			res.append ( QString ( "Key points per frame       : %1\n" ).arg ( QString::number ( max_key_points ) ) );
+		} else {
+			res.append ( QString ( "All the detected key points\n" ) );
+		}
+
+		if ( IsDepthFiltered ( ) ) {
+			res.append ( QString ( "Depth filter radius        : %1\n" ).arg ( QString::number ( depth_filter_radius ) ) );
+			res.append ( QString ( "Max depth step             : %1\n" ).arg ( QString::number ( max_depth_step ) ) );
+		} else {
+			res.append ( QString ( "Key points without depth are kept\n" ) );
+		}
+
+		res.append ( QString ( "----------------------------------\n" ) );
+		return res;
+	}
+
+	FeatureExtractor::FeatureExtractor ( Feature::Type type , const DetectionParameters & parameters ) :
+			type_ ( type ) ,
+			parameters_ ( parameters ) { }
+
+	Feature FeatureExtractor::Extract ( const cv::Mat_ < uchar > & gray_image , const cv::Mat_ < ushort > & depth_image ) const {
+
+		ExtractionEngine * engine = GetEngine ( type_ );
+
+		if ( !engine or gray_image.empty ( ) ) {
+			return Feature ( type_ , Feature::KeyPoints ( ) , Feature::Descriptors ( ) );
+		}
+
+		engine->key_points.clear ( );
+
+		Feature::Descriptors descriptors;
+
+		// Not in one pass (Feature2D::operator()) : DescriptorExtractor::compute drops the key points at the border or
+		// without size, as Feature ( image , type ) does
+		if ( engine->feature2d ) {
+			engine->feature2d->detect ( gray_image , engine->key_points );
+		} else {
+			engine->detector->detect ( gray_image , engine->key_points );
+		}
+
+		if ( parameters_.IsDepthFiltered ( ) and !depth_image.empty ( ) ) {
+			FilterKeyPointsByDepth ( parameters_ , depth_image , engine->key_points );
+		}
+
+		if ( parameters_.IsBucketed ( ) ) {
+			BucketKeyPoints ( parameters_ , gray_image.rows , gray_image.cols , * engine );
+		}
+
+		if ( engine->feature2d ) {
+			engine->feature2d->compute ( gray_image , engine->key_points , descriptors );
+		} else {
+			engine->extractor->compute ( gray_image , engine->key_points , descriptors );
+		}
+
+		return Feature ( type_ , engine->key_points , descriptors );
+	}
+
+	std::vector < Feature > FeatureExtractor::Extract ( const std::vector < cv::Mat_ < uchar > > & gray_images ,
+	                                                    const std::vector < cv::Mat_ < ushort > > & depth_images ) const {
+
+		std::vector < Feature > features ( gray_images.size ( ) );
+
+		cv::parallel_for_ ( cv::Range ( 0 , static_cast < int > ( gray_images.size ( ) ) ) , ParallelRange ( [ & ] ( const cv::Range & range ) {
+
+			for ( auto i = range.start ; i < range.end ; ++i ) {
+				features[ i ] = depth_images.empty ( ) ? Extract ( gray_images[ i ] ) : Extract ( gray_images[ i ] , depth_images[ i ] );
+			}
+		} ) );
+
+		return features;
+	}
+
+}
@@ -0,0 +1,477 @@
+#include "Core/FeatureStore.h"
+#include "Core/MappedRawData.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+namespace NiS {
+
+	static_assert ( std::is_pod < FeatureStoreHeader >::value , "FeatureStoreHeader is written as is" );
+	static_assert ( std::is_pod < FeatureStoreEntry >::value , "FeatureStoreEntry is written as is" );
+
+	namespace {
+
+		struct PackedKeyPoint
+		{
+			float        x;
+			float        y;
+			float        size;
+			float        angle;
+			float        response;
+			std::int32_t octave;
+			std::int32_t class_id;
+		};
+
+		std::vector < char > Compress ( const char * data , std::size_t size ) {
+
+			namespace bio = boost::iostreams;
+
+			std::vector < char > compressed;
+
+			// The chain is flushed and closed by the destructor of the stream
+			{
+				bio::filtering_ostream out;
+				out.push ( bio::zlib_compressor ( bio::zlib::best_speed ) );
+				out.push ( bio::back_inserter ( compressed ) );
+				out.write ( data , size );
+			}
+
+			return compressed;
+		}
+
+		bool Decompress ( const char * data , std::size_t size , char * out , std::size_t out_size ) {
+
+			namespace bio = boost::iostreams;
+
+			try {
+
+				bio::filtering_istream in;
+				in.push ( bio::zlib_decompressor ( ) );
+				in.push ( bio::array_source ( data , size ) );
+				in.read ( out , out_size );
+
+				return static_cast < std::size_t > ( in.gcount ( ) ) == out_size;
+			}
+			catch ( const std::exception & e ) {
+
+				std::cout << "Broken key points in feature store (" << e.what ( ) << ")" << std::endl;
+				return false;
+			}
+		}
+
+		std::size_t GetDescriptorsSize ( const FeatureStoreEntry & entry ) {
+
+			return CV_ELEM_SIZE ( entry.descriptor_type ) *
+			       static_cast < std::size_t > ( std::max ( entry.descriptor_rows , 0 ) ) *
+			       static_cast < std::size_t > ( std::max ( entry.descriptor_cols , 0 ) );
+		}
+
+		Feature::KeyPoints UnpackKeyPoints ( const std::vector < PackedKeyPoint > & packed ) {
+
+			Feature::KeyPoints key_points;
+			key_points.reserve ( packed.size ( ) );
+
+			for ( const auto & p : packed ) {
+				key_points.push_back ( cv::KeyPoint ( p.x , p.y , p.size , p.angle , p.response , p.octave , p.class_id ) );
+			}
+
+			return key_points;
+		}
+
+		// Feature of an entry from its compressed key points and its descriptors (not copied, kept alive by storage)
+		bool DecodeFeature ( const FeatureStoreEntry & entry , const char * key_points , const cv::Mat & descriptors ,
+		                     const std::shared_ptr < void > & storage , Feature & feature ) {
+
+			std::vector < PackedKeyPoint > packed ( static_cast < std::size_t > ( std::max ( entry.key_point_count , 0 ) ) );
+
+			if ( !packed.empty ( ) and
+			     !Decompress ( key_points , entry.key_points_size ,
+			                   reinterpret_cast < char * > ( packed.data ( ) ) , sizeof ( PackedKeyPoint ) * packed.size ( ) ) ) {
+				return false;
+			}
+
+			feature = Feature ( static_cast < Feature::Type > ( entry.type ) , UnpackKeyPoints ( packed ) , descriptors , storage );
+
+			return true;
+		}
+
+		// Descriptors of an entry of a mapped store, not copied
+		cv::Mat GetMappedDescriptors ( const char * data , const FeatureStoreEntry & entry ) {
+
+			if ( GetDescriptorsSize ( entry ) == 0 ) {
+				return cv::Mat ( );
+			}
+
+			return cv::Mat ( entry.descriptor_rows , entry.descriptor_cols , entry.descriptor_type ,
+			                 const_cast < char * > ( data + entry.descriptors_offset ) );
+		}
+
+		std::mutex & GetStoresMutex ( ) {
+
+			static std::mutex mutex;
+			return mutex;
+		}
+
+		std::map < std::string , std::shared_ptr < FeatureStore > > & GetStores ( ) {
+
+			static std::map < std::string , std::shared_ptr < FeatureStore > > stores;
+			return stores;
+		}
+
+		std::uint64_t AlignedSize ( std::uint64_t size ) {
+
+			return ( size + kFeatureStoreAlignment - 1 ) / kFeatureStoreAlignment * kFeatureStoreAlignment;
+		}
+
+		void WritePadding ( std::ostream & out ) {
+
+			const std::uint64_t position = static_cast < std::uint64_t > ( out.tellp ( ) );
+			const std::uint64_t padding  = ( kFeatureStoreAlignment - position % kFeatureStoreAlignment ) % kFeatureStoreAlignment;
+
+			const std::vector < char > zeros ( padding , 0 );
+			out.write ( zeros.data ( ) , zeros.size ( ) );
+		}
+	}
+
+	FeatureStore::FeatureStore ( const std::string & file_name ) :
+			name_ ( file_name ) ,
+			stale_bytes_ ( 0 ) {
+
+		Map ( );
+	}
+
+	FeatureStore::~FeatureStore ( ) {
+
+		Flush ( );
+	}
+
+	std::shared_ptr < FeatureStore > FeatureStore::Open ( const std::string & dir_path ) {
+
+		const std::string file_name = ( boost::filesystem::path ( dir_path ) / kFeatureStoreFileName ).string ( );
+
+		std::lock_guard < std::mutex > lock ( GetStoresMutex ( ) );
+
+		auto & store = GetStores ( )[ file_name ];
+		if ( !store ) {
+			store = std::make_shared < FeatureStore > ( file_name );
+		}
+
+		return store;
+	}
+
+	bool FeatureStore::Map ( ) {
+
+		namespace bio = boost::iostreams;
+
+		file_.reset ( );
+		index_.clear ( );
+		stale_bytes_ = 0;
+
+		if ( !boost::filesystem::exists ( name_ ) ) {
+			return true;
+		}
+
+		try {
+			file_ = std::make_shared < bio::mapped_file_source > ( name_ );
+		}
+		catch ( const std::exception & e ) {
+
+			std::cout << "File mapping failed : " << name_ << " (" << e.what ( ) << ")" << std::endl;
+			file_.reset ( );
+			return false;
+		}
+
+		const char        * data = file_->data ( );
+		const std::size_t size   = file_->size ( );
+
+		FeatureStoreHeader header;
+
+		if ( size >= sizeof ( header ) ) {
+			std::memcpy ( & header , data , sizeof ( header ) );
+		}
+
+		if ( size < sizeof ( header ) or
+		     std::memcmp ( header.magic , kFeatureStoreMagic , sizeof ( header.magic ) ) != 0 or
+		     header.version > kFeatureStoreVersion or header.entry_count < 0 or
+		     header.index_offset + sizeof ( FeatureStoreEntry ) * header.entry_count > size ) {
+
+			// Rewritten from scratch by the next Flush
+			std::cout << "Broken feature store : " << name_ << std::endl;
+			file_.reset ( );
+			return false;
+		}
+
+		// Payloads start aligned and are padded to the alignment, the rest before the index is stale
+		std::uint64_t live_bytes = AlignedSize ( sizeof ( header ) );
+
+		for ( auto i = 0 ; i < header.entry_count ; ++i ) {
+
+			FeatureStoreEntry entry;
+			std::memcpy ( & entry , data + header.index_offset + sizeof ( entry ) * i , sizeof ( entry ) );
+
+			if ( entry.key_points_offset + entry.key_points_size > size or
+			     entry.descriptors_offset + GetDescriptorsSize ( entry ) > size ) {
+				std::cout << "Broken feature store entry " << i << " in : " << name_ << std::endl;
+				continue;
+			}
+
+			const FeatureKey key { std::string ( entry.frame , strnlen ( entry.frame , sizeof ( entry.frame ) ) ) ,
+			                       static_cast < Feature::Type > ( entry.type ) ,
+			                       entry.parameters };
+
+			index_[ key ] = entry;
+			live_bytes += AlignedSize ( entry.key_points_size ) + AlignedSize ( GetDescriptorsSize ( entry ) );
+		}
+
+		stale_bytes_ = header.index_offset > live_bytes ? header.index_offset - live_bytes : 0;
+
+		// The features of a dataset are usually all needed, read the payloads in one go.
+		PrefetchMappedRange ( data , sizeof ( header ) , header.index_offset );
+
+		return true;
+	}
+
+	bool FeatureStore::Load ( const FeatureKey & key , Feature & feature ) const {
+
+		FeatureStoreEntry                                         entry;
+		std::shared_ptr < const std::vector < char > >            key_points;
+		cv::Mat                                                   descriptors;
+		std::shared_ptr < boost::iostreams::mapped_file_source > file;
+
+		// Only the lookup holds the lock, the features are decompressed in parallel. The mapping and the pending
+		// buffers are shared : a Flush meanwhile does not invalidate them.
+		{
+			std::lock_guard < std::mutex > lock ( mutex_ );
+
+			auto pending = pending_.find ( key );
+
+			if ( pending != pending_.end ( ) ) {
+
+				entry       = pending->second.entry;
+				key_points  = pending->second.key_points;
+				descriptors = pending->second.descriptors;
+			} else {
+
+				auto itr = index_.find ( key );
+
+				if ( itr == index_.end ( ) or !file_ ) {
+					return false;
+				}
+
+				entry = itr->second;
+				file  = file_;
+			}
+		}
+
+		// Pending descriptors are owned by their Mat, which is never written after Store
+		if ( file ) {
+			return DecodeFeature ( entry , file->data ( ) + entry.key_points_offset , GetMappedDescriptors ( file->data ( ) , entry ) ,
+			                       file , feature );
+		}
+
+		return DecodeFeature ( entry , key_points->data ( ) , descriptors , std::shared_ptr < void > ( ) , feature );
+	}
+
+	bool FeatureStore::Store ( const FeatureKey & key , const Feature & feature ) {
+
+		Pending p;
+		std::memset ( & p.entry , 0 , sizeof ( p.entry ) );
+
+		if ( key.frame.size ( ) >= sizeof ( p.entry.frame ) ) {
+			std::cout << "Frame name too long for the feature store : " << key.frame << std::endl;
+			return false;
+		}
+
+		std::vector < PackedKeyPoint > packed;
+		packed.reserve ( feature.GetKeyPoints ( ).size ( ) );
+
+		for ( const auto & k : feature.GetKeyPoints ( ) ) {
+			packed.push_back ( PackedKeyPoint { k.pt.x , k.pt.y , k.size , k.angle , k.response , k.octave , k.class_id } );
+		}
+
+		p.key_points  = std::make_shared < const std::vector < char > > (
+				Compress ( reinterpret_cast < const char * > ( packed.data ( ) ) , sizeof ( PackedKeyPoint ) * packed.size ( ) ) );
+		p.descriptors = feature.GetDescriptors ( ).clone ( );
+
+		p.entry.parameters      = key.parameters;
+		p.entry.key_points_size = static_cast < std::uint32_t > ( p.key_points->size ( ) );
+		p.entry.key_point_count = static_cast < std::int32_t > ( packed.size ( ) );
+		p.entry.type            = key.type;
+		p.entry.descriptor_rows = p.descriptors.rows;
+		p.entry.descriptor_cols = p.descriptors.cols;
+		p.entry.descriptor_type = p.descriptors.type ( );
+		std::memcpy ( p.entry.frame , key.frame.data ( ) , key.frame.size ( ) );
+
+		std::lock_guard < std::mutex > lock ( mutex_ );
+
+		pending_[ key ] = std::move ( p );
+
+		return true;
+	}
+
+	bool FeatureStore::Flush ( ) {
+
+		std::lock_guard < std::mutex > lock ( mutex_ );
+
+		if ( pending_.empty ( ) ) {
+			return true;
+		}
+
+		// Appending leaves the payloads of re-stored features and the previous index behind, those are reclaimed by
+		// writing a compacted copy of the store that replaces it. A missing or broken file is written from scratch.
+		bool superseded = false;
+		for ( const auto & pending : pending_ ) {
+			superseded = superseded or index_.count ( pending.first ) > 0;
+		}
+
+		const bool        compact  = file_ and ( superseded or stale_bytes_ * 4 >= file_->size ( ) );
+		const bool        append   = file_ and !compact;
+		const std::string out_name = compact ? name_ + ".tmp" : name_;
+
+		// Compaction copies the kept payloads from the current mapping, appending writes behind it
+		std::shared_ptr < boost::iostreams::mapped_file_source > previous = file_;
+		file_.reset ( );
+
+		if ( append ) {
+			previous.reset ( );
+		}
+
+		std::fstream out ( out_name , append ? std::ios::in | std::ios::out | std::ios::binary
+		                                     : std::ios::out | std::ios::trunc | std::ios::binary );
+
+		if ( !out ) {
+			std::cout << "Cannot write feature store : " << out_name << std::endl;
+			Map ( );
+			return false;
+		}
+
+		FeatureStoreHeader header;
+		std::memset ( & header , 0 , sizeof ( header ) );
+
+		if ( append ) {
+			out.seekp ( 0 , std::ios::end );
+		} else {
+			// Placeholder, the final header is written last
+			out.write ( reinterpret_cast < const char * > ( & header ) , sizeof ( header ) );
+		}
+
+		auto write_payload = [ & out ] ( FeatureStoreEntry & entry , const char * key_points , const char * descriptors ) {
+
+			WritePadding ( out );
+			entry.key_points_offset = static_cast < std::uint64_t > ( out.tellp ( ) );
+			out.write ( key_points , entry.key_points_size );
+
+			WritePadding ( out );
+			entry.descriptors_offset = static_cast < std::uint64_t > ( out.tellp ( ) );
+			out.write ( descriptors , GetDescriptorsSize ( entry ) );
+		};
+
+		std::map < FeatureKey , FeatureStoreEntry > entries;
+
+		if ( append ) {
+			entries = index_;
+		}
+
+		if ( compact ) {
+
+			const char * data = previous->data ( );
+
+			for ( const auto & stored : index_ ) {
+
+				if ( pending_.count ( stored.first ) ) {
+					continue;
+				}
+
+				FeatureStoreEntry entry = stored.second;
+				write_payload ( entry , data + stored.second.key_points_offset , data + stored.second.descriptors_offset );
+				entries[ stored.first ] = entry;
+			}
+		}
+
+		for ( auto & pending : pending_ ) {
+
+			Pending & p = pending.second;
+
+			write_payload ( p.entry , p.key_points->data ( ) , reinterpret_cast < const char * > ( p.descriptors.data ) );
+			entries[ pending.first ] = p.entry;
+		}
+
+		WritePadding ( out );
+		header.index_offset = static_cast < std::uint64_t > ( out.tellp ( ) );
+
+		for ( const auto & entry : entries ) {
+			out.write ( reinterpret_cast < const char * > ( & entry.second ) , sizeof ( entry.second ) );
+		}
+
+		out.flush ( );
+
+		std::memcpy ( header.magic , kFeatureStoreMagic , sizeof ( header.magic ) );
+		header.version     = kFeatureStoreVersion;
+		header.entry_count = static_cast < std::int32_t > ( entries.size ( ) );
+
+		out.seekp ( 0 );
+		out.write ( reinterpret_cast < const char * > ( & header ) , sizeof ( header ) );
+		out.close ( );
+
+		bool written = !out.fail ( );
+
+		// The compacted copy replaces the store at once, the previous one stays valid until then
+		if ( written and compact ) {
+
+			boost::system::error_code error;
+			boost::filesystem::rename ( out_name , name_ , error );
+
+			if ( error ) {
+				boost::filesystem::remove ( out_name , error );
+				written = false;
+			}
+		}
+
+		if ( written ) {
+			pending_.clear ( );
+		} else {
+			std::cout << "Writing feature store failed : " << name_ << std::endl;
+		}
+
+		previous.reset ( );
+
+		Map ( );
+
+		return written;
+	}
+
+	int FeatureStore::GetFeatureCount ( ) const {
+
+		std::lock_guard < std::mutex > lock ( mutex_ );
+
+		int count = static_cast < int > ( index_.size ( ) );
+		for ( const auto & pending : pending_ ) {
+			count += index_.count ( pending.first ) ? 0 : 1;
+		}
+
+		return count;
+	}
+
+	void FlushFeatureStores ( ) {
+
+		std::map < std::string , std::shared_ptr < FeatureStore > > stores;
+
+		{
+			std::lock_guard < std::mutex > lock ( GetStoresMutex ( ) );
+			stores.swap ( GetStores ( ) );
+		}
+
+		for ( auto & store : stores ) {
+			store.second->Flush ( );
+		}
+	}
+
+}
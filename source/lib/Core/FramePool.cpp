@@ -0,0 +1,162 @@
+#include "Core/FramePool.h"
+
+#include <iterator>
+
+namespace NiS {
+
+	const std::size_t FramePool::kMinPooledBytes;
+	const std::size_t FramePool::kDefaultCapacityBytes;
+
+	FramePool & FramePool::Instance ( ) {
+
+		static FramePool * pool = new FramePool ( );
+		return * pool;
+	}
+
+	FramePool::FramePool ( std::size_t capacity_bytes ) :
+			capacity_bytes_ ( capacity_bytes ) ,
+			statistics_ ( ) { }
+
+	FramePool::~FramePool ( ) {
+
+		Clear ( );
+	}
+
+	void FramePool::allocate ( int dims , const int * sizes , int type , int *& refcount ,
+	                           uchar *& datastart , uchar *& data , size_t * step ) {
+
+		step[ dims - 1 ] = CV_ELEM_SIZE ( type );
+
+		for ( auto i = dims - 2 ; i >= 0 ; --i ) {
+			step[ i ] = step[ i + 1 ] * sizes[ i + 1 ];
+		}
+
+		// Same layout as cv::Mat::create : the reference count follows the data
+		const std::size_t size = cv::alignSize ( step[ 0 ] * sizes[ 0 ] , static_cast < int > ( sizeof ( * refcount ) ) );
+
+		uchar * buffer = nullptr;
+
+		if ( size >= kMinPooledBytes ) {
+
+			std::lock_guard < std::mutex > lock ( mutex_ );
+
+			auto itr = buffers_.find ( size );
+
+			if ( itr != buffers_.end ( ) and !itr->second.empty ( ) ) {
+
+				buffer = itr->second.back ( );
+				itr->second.pop_back ( );
+
+				++statistics_.hits;
+				--statistics_.cached_buffers;
+				statistics_.cached_bytes -= size;
+			} else {
+				++statistics_.misses;
+			}
+		}
+
+		if ( !buffer ) {
+			buffer = static_cast < uchar * > ( cv::fastMalloc ( size + sizeof ( * refcount ) ) );
+		}
+
+		datastart = data = buffer;
+		refcount  = reinterpret_cast < int * > ( buffer + size );
+		* refcount = 1;
+	}
+
+	void FramePool::deallocate ( int * refcount , uchar * datastart , uchar * data ) {
+
+		if ( !datastart ) {
+			return;
+		}
+
+		const std::size_t size = static_cast < std::size_t > ( reinterpret_cast < uchar * > ( refcount ) - datastart );
+
+		if ( size >= kMinPooledBytes ) {
+
+			std::lock_guard < std::mutex > lock ( mutex_ );
+
+			if ( statistics_.cached_bytes + size <= capacity_bytes_ ) {
+
+				buffers_[ size ].push_back ( datastart );
+
+				++statistics_.recycled;
+				++statistics_.cached_buffers;
+				statistics_.cached_bytes += size;
+				return;
+			}
+
+			++statistics_.dropped;
+		}
+
+		cv::fastFree ( datastart );
+	}
+
+	void FramePool::SetCapacity ( std::size_t capacity_bytes ) {
+
+		std::lock_guard < std::mutex > lock ( mutex_ );
+
+		capacity_bytes_ = capacity_bytes;
+		Trim ( );
+	}
+
+	std::size_t FramePool::GetCapacity ( ) const {
+
+		std::lock_guard < std::mutex > lock ( mutex_ );
+
+		return capacity_bytes_;
+	}
+
+	void FramePool::Clear ( ) {
+
+		std::lock_guard < std::mutex > lock ( mutex_ );
+
+		for ( auto & buffers : buffers_ ) {
+			for ( auto buffer : buffers.second ) {
+				cv::fastFree ( buffer );
+			}
+		}
+
+		buffers_.clear ( );
+		statistics_.cached_buffers = 0;
+		statistics_.cached_bytes   = 0;
+	}
+
+	FramePoolStatistics FramePool::GetStatistics ( ) const {
+
+		std::lock_guard < std::mutex > lock ( mutex_ );
+
+		return statistics_;
+	}
+
+	void FramePool::ResetStatistics ( ) {
+
+		std::lock_guard < std::mutex > lock ( mutex_ );
+
+		// The cached buffers are still there
+		statistics_.hits     = 0;
+		statistics_.misses   = 0;
+		statistics_.recycled = 0;
+		statistics_.dropped  = 0;
+	}
+
+	void FramePool::Trim ( ) {
+
+		for ( auto itr = buffers_.begin ( ) ; itr != buffers_.end ( ) and statistics_.cached_bytes > capacity_bytes_ ; ) {
+
+			auto & buffers = itr->second;
+
+			while ( !buffers.empty ( ) and statistics_.cached_bytes > capacity_bytes_ ) {
+
+				cv::fastFree ( buffers.back ( ) );
+				buffers.pop_back ( );
+
+				--statistics_.cached_buffers;
+				statistics_.cached_bytes -= itr->first;
+			}
+
+			itr = buffers.empty ( ) ? buffers_.erase ( itr ) : std::next ( itr );
+		}
+	}
+
+}
@@ -0,0 +1,377 @@
+#include "Core/MappedRawData.h"
+#include "Core/DepthCodec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include <stdexcept>
+
+#include <boost/filesystem.hpp>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace NiS {
+
+#if defined(__unix__) || defined(__APPLE__)
+
+	FileMapping::FileMapping ( const std::string & file_name ) :
+			data_ ( nullptr ) ,
+			size_ ( 0 ) {
+
+		const int fd = open ( file_name.c_str ( ) , O_RDONLY );
+
+		if ( fd < 0 ) {
+			throw std::runtime_error ( "can not open the file" );
+		}
+
+		struct stat status;
+
+		if ( fstat ( fd , & status ) != 0 or status.st_size <= 0 ) {
+			close ( fd );
+			throw std::runtime_error ( "empty file" );
+		}
+
+		void * data = mmap ( nullptr , static_cast < std::size_t > ( status.st_size ) , PROT_READ | PROT_WRITE , MAP_PRIVATE , fd , 0 );
+
+		// The mapping keeps its own reference to the file
+		close ( fd );
+
+		if ( data == MAP_FAILED ) {
+			throw std::runtime_error ( "mmap failed" );
+		}
+
+		data_ = static_cast < char * > ( data );
+		size_ = static_cast < std::size_t > ( status.st_size );
+	}
+
+	FileMapping::~FileMapping ( ) {
+
+		munmap ( data_ , size_ );
+	}
+
+#else
+
+	FileMapping::FileMapping ( const std::string & file_name ) :
+			data_ ( nullptr ) ,
+			size_ ( 0 ) {
+
+		namespace bio = boost::iostreams;
+
+		bio::mapped_file_params params ( file_name );
+		params.flags = bio::mapped_file::priv;
+
+		file_.open ( params );
+
+		data_ = file_.data ( );
+		size_ = file_.size ( );
+	}
+
+	FileMapping::~FileMapping ( ) { }
+
+#endif
+
+	MappedRawDataFile::MappedRawDataFile ( ) :
+			version_ ( 0 ) { }
+
+	MappedRawDataFile::MappedRawDataFile ( const std::string & file_name ) :
+			name_ ( file_name ) ,
+			version_ ( 0 ) {
+
+		try {
+			file_ = std::make_shared < FileMapping > ( file_name );
+		}
+		catch ( const std::exception & e ) {
+
+			std::cout << "File mapping failed : " << file_name << " (" << e.what ( ) << ")" << std::endl;
+			file_.reset ( );
+			return;
+		}
+
+		if ( !Parse ( ) ) {
+			file_.reset ( );
+		}
+	}
+
+	RawDataFrame MappedRawDataFile::GetFrame ( int index , bool decode_depth ) const {
+
+		RawDataFrame frame;
+
+		if ( IsOpen ( ) and 0 <= index and index < GetFrameCount ( ) ) {
+
+			const MatLayout & depth = layouts_[ index ].depth;
+
+			if ( !decode_depth and depth.encoded > 0 ) {
+
+				// Only the mapping is kept, the decoded images come and go with their keyframes
+				const std::shared_ptr < FileMapping > file = file_;
+
+				frame.decode_depth = [ file , depth ] ( RawDataFrame::DepthImage & depth_image ) {
+
+					return DecodeDepthImage ( reinterpret_cast < const uchar * > ( file->GetData ( ) ) + depth.offset , depth.encoded , depth_image );
+				};
+				frame.encoded_depth_size = cv::Size ( depth.cols , depth.rows );
+			}
+
+			// A corrupt depth block fails the frame as a truncated one does
+			if ( !CreateMat ( layouts_[ index ].color , frame.color_image ) or
+			     ( !frame.decode_depth and !CreateMat ( depth , frame.depth_image ) ) ) {
+				std::cout << "Corrupt frame " << index << " in : " << name_ << std::endl;
+				return RawDataFrame ( );
+			}
+
+			frame.name        = name_;
+			frame.id          = index;
+			frame.storage     = file_;
+		}
+
+		return frame;
+	}
+
+	RawDataFrames MappedRawDataFile::GetFrames ( ) const {
+
+		RawDataFrames frames;
+		frames.reserve ( layouts_.size ( ) );
+
+		for ( auto i = 0 ; i < GetFrameCount ( ) ; ++i ) {
+			frames.push_back ( GetFrame ( i ) );
+		}
+
+		return frames;
+	}
+
+	void MappedRawDataFile::Prefetch ( int index ) const {
+
+		if ( !IsOpen ( ) or index < 0 or index >= GetFrameCount ( ) ) {
+			return;
+		}
+
+		const FrameLayout & layout = layouts_[ index ];
+
+		std::size_t depth_size = layout.depth.encoded;
+
+		if ( depth_size == 0 ) {
+			GetMatByteSize ( layout.depth.rows , layout.depth.cols , layout.depth.type , depth_size );
+		}
+
+		const std::size_t begin = layout.color.offset;
+		const std::size_t end   = layout.depth.offset + depth_size;
+
+		PrefetchMappedRange ( file_->GetData ( ) , begin , end );
+	}
+
+	bool MappedRawDataFile::Parse ( ) {
+
+		const char        * data = file_->GetData ( );
+		const std::size_t size   = file_->GetSize ( );
+
+		const std::size_t header_size = kRawDataFrameHeader.size ( ) + sizeof ( int ) * 2;
+
+		if ( size < header_size or
+		     std::memcmp ( data , kRawDataFrameHeader.data ( ) , kRawDataFrameHeader.size ( ) ) != 0 ) {
+			std::cout << "Not a XTION DATA file : " << name_ << std::endl;
+			return false;
+		}
+
+		std::size_t offset = kRawDataFrameHeader.size ( );
+
+		int count;
+		std::memcpy ( & version_ , data + offset , sizeof ( int ) );
+		offset += sizeof ( int );
+		std::memcpy ( & count , data + offset , sizeof ( int ) );
+		offset += sizeof ( int );
+
+		layouts_.clear ( );
+		// A frame takes 2 image headers at least, a broken count does not make a huge reservation
+		layouts_.reserve ( std::min ( static_cast < std::size_t > ( std::max ( count , 0 ) ) , size / ( sizeof ( int ) * 6 ) ) );
+
+		for ( auto i = 0 ; i < count ; ++i ) {
+
+			FrameLayout layout;
+
+			const bool parsed = ParseMat ( offset , layout.color ) and
+			                    ( ( version_ & kRawDataFrameDepthCodecFlag ) ? ParseEncodedDepth ( offset , layout.depth )
+			                                                                 : ParseMat ( offset , layout.depth ) );
+
+			// A truncated file still gives access to the frames before the broken one.
+			if ( !parsed ) {
+				std::cout << "Truncated frame " << i << " in : " << name_ << std::endl;
+				break;
+			}
+
+			layouts_.push_back ( layout );
+		}
+
+		return true;
+	}
+
+	bool MappedRawDataFile::ParseMat ( std::size_t & offset , MatLayout & layout ) const {
+
+		const char        * data = file_->GetData ( );
+		const std::size_t size   = file_->GetSize ( );
+
+		if ( offset + sizeof ( int ) * 3 > size ) {
+			return false;
+		}
+
+		std::memcpy ( & layout.rows , data + offset , sizeof ( int ) );
+		std::memcpy ( & layout.cols , data + offset + sizeof ( int ) , sizeof ( int ) );
+		std::memcpy ( & layout.type , data + offset + sizeof ( int ) * 2 , sizeof ( int ) );
+		offset += sizeof ( int ) * 3;
+
+		layout.offset  = offset;
+		layout.encoded = 0;
+
+		// Compared with the bytes left, offset + byte_size could wrap
+		std::size_t byte_size;
+
+		if ( !GetMatByteSize ( layout.rows , layout.cols , layout.type , byte_size ) or byte_size > size - offset ) {
+			return false;
+		}
+
+		offset += byte_size;
+
+		return true;
+	}
+
+	bool MappedRawDataFile::ParseEncodedDepth ( std::size_t & offset , MatLayout & layout ) const {
+
+		const uchar       * data = reinterpret_cast < const uchar * > ( file_->GetData ( ) );
+		const std::size_t size   = file_->GetSize ( );
+
+		const std::size_t encoded = GetEncodedDepthImageSize ( data + offset , size - std::min ( offset , size ) );
+
+		if ( encoded == 0 or encoded > size - offset ) {
+			return false;
+		}
+
+		std::memcpy ( & layout.rows , data + offset , sizeof ( int ) );
+		std::memcpy ( & layout.cols , data + offset + sizeof ( int ) , sizeof ( int ) );
+
+		std::size_t byte_size;
+
+		if ( !GetMatByteSize ( layout.rows , layout.cols , CV_16UC1 , byte_size ) ) {
+			return false;
+		}
+
+		layout.type    = CV_16UC1;
+		layout.offset  = offset;
+		layout.encoded = encoded;
+
+		offset += encoded;
+
+		return true;
+	}
+
+	bool MappedRawDataFile::CreateMat ( const MatLayout & layout , cv::Mat & mat ) const {
+
+		// The dimensions are checked by the parsing : not negative, the data within the file
+		if ( layout.rows == 0 or layout.cols == 0 ) {
+			mat = cv::Mat ( );
+			return true;
+		}
+
+		if ( layout.encoded > 0 ) {
+
+			cv::Mat_ < ushort > depth_image;
+
+			if ( !DecodeDepthImage ( reinterpret_cast < const uchar * > ( file_->GetData ( ) ) + layout.offset , layout.encoded , depth_image ) ) {
+				return false;
+			}
+
+			mat = depth_image;
+			return true;
+		}
+
+		// No copy, the header refers to the (private) mapped pages.
+		mat = cv::Mat ( layout.rows , layout.cols , layout.type , file_->GetData ( ) + layout.offset );
+		return true;
+	}
+
+	bool GetMatByteSize ( int rows , int cols , int type , std::size_t & byte_size ) {
+
+		if ( rows < 0 or cols < 0 ) {
+			return false;
+		}
+
+		const std::size_t elements = static_cast < std::size_t > ( rows ) * static_cast < std::size_t > ( cols );
+		const std::size_t element  = CV_ELEM_SIZE ( type );
+
+		if ( element != 0 and elements > std::numeric_limits < std::size_t >::max ( ) / element ) {
+			return false;
+		}
+
+		byte_size = elements * element;
+		return true;
+	}
+
+	void PrefetchMappedRange ( const char * data , std::size_t begin , std::size_t end ) {
+
+		if ( end <= begin ) {
+			return;
+		}
+
+		std::size_t page_size = 4096;
+
+#if defined(__unix__) || defined(__APPLE__)
+		page_size = static_cast < std::size_t > ( sysconf ( _SC_PAGESIZE ) );
+
+		// madvise wants a page aligned address
+		const std::size_t aligned_begin = begin - begin % page_size;
+		posix_madvise ( const_cast < char * > ( data ) + aligned_begin , end - aligned_begin , POSIX_MADV_WILLNEED );
+#endif
+
+		// Touch one byte per page so that the calling thread does the actual reading.
+		const volatile char * bytes = data;
+		char sum = 0;
+		for ( std::size_t offset = begin ; offset < end ; offset += page_size ) {
+			sum ^= bytes[ offset ];
+		}
+		( void ) sum;
+	}
+
+	RawDataFrames MapRawDataFrames ( const std::string & file_name ) {
+
+		return MappedRawDataFile ( file_name ).GetFrames ( );
+	}
+
+	RawDataFrames MapRawDataDirectory ( const std::string & dir_path ) {
+
+		namespace fs = boost::filesystem;
+
+		std::vector < std::string > file_names;
+
+		if ( fs::is_directory ( dir_path ) ) {
+			for ( fs::directory_iterator itr ( dir_path ) ; itr != fs::directory_iterator ( ) ; ++itr ) {
+				if ( fs::is_regular_file ( itr->status ( ) ) and itr->path ( ).extension ( ) == ".dat" ) {
+					file_names.push_back ( fs::absolute ( itr->path ( ) ).string ( ) );
+				}
+			}
+		}
+
+		std::sort ( file_names.begin ( ) , file_names.end ( ) );
+
+		RawDataFrames frames;
+		frames.reserve ( file_names.size ( ) );
+
+		for ( const auto & file_name : file_names ) {
+
+			MappedRawDataFile file ( file_name );
+
+			if ( file.IsOpen ( ) and file.GetFrameCount ( ) > 0 ) {
+				RawDataFrame frame = file.GetFrame ( 0 );
+				frame.id = static_cast < int > ( frames.size ( ) );
+				frames.push_back ( frame );
+			}
+		}
+
+		return frames;
+	}
+
+}
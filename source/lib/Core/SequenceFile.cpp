@@ -0,0 +1,402 @@
+#include "Core/SequenceFile.h"
+#include "Core/MappedRawData.h"
+#include "Core/DepthCodec.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+
+#include <boost/filesystem.hpp>
+
+namespace NiS {
+
+	static_assert ( std::is_pod < SequenceFileHeader >::value , "SequenceFileHeader is written as is" );
+	static_assert ( std::is_pod < SequenceFrameEntry >::value , "SequenceFrameEntry is written as is" );
+
+	bool IsSequenceFile ( const std::string & file_name ) {
+
+		return boost::filesystem::path ( file_name ).extension ( ) == kSequenceFileExtension;
+	}
+
+	//----------------------------------------------
+	// Reader
+
+	SequenceFileReader::SequenceFileReader ( ) :
+			frame_count_ ( 0 ) ,
+			table_ ( nullptr ) { }
+
+	SequenceFileReader::SequenceFileReader ( const std::string & file_name ) :
+			name_ ( file_name ) ,
+			frame_count_ ( 0 ) ,
+			table_ ( nullptr ) {
+
+		namespace bio = boost::iostreams;
+
+		try {
+
+			bio::mapped_file_params params ( file_name );
+			params.flags = bio::mapped_file::priv;
+
+			file_ = std::make_shared < bio::mapped_file > ( params );
+		}
+		catch ( const std::exception & e ) {
+
+			std::cout << "File mapping failed : " << file_name << " (" << e.what ( ) << ")" << std::endl;
+			file_.reset ( );
+			return;
+		}
+
+		const std::size_t size = file_->size ( );
+
+		SequenceFileHeader header;
+
+		if ( size < sizeof ( header ) ) {
+			std::cout << "Not a sequence file : " << file_name << std::endl;
+			file_.reset ( );
+			return;
+		}
+
+		std::memcpy ( & header , file_->const_data ( ) , sizeof ( header ) );
+
+		if ( std::memcmp ( header.magic , kSequenceFileMagic , sizeof ( header.magic ) ) != 0 or
+		     header.version > kSequenceFileVersion or header.frame_count < 0 or
+		     header.table_offset % alignof ( SequenceFrameEntry ) != 0 or header.table_offset > size or
+		     static_cast < std::uint64_t > ( header.frame_count ) > ( size - header.table_offset ) / sizeof ( SequenceFrameEntry ) ) {
+			std::cout << "Broken sequence file : " << file_name << std::endl;
+			file_.reset ( );
+			return;
+		}
+
+		frame_count_ = header.frame_count;
+		table_       = reinterpret_cast < const SequenceFrameEntry * > ( file_->const_data ( ) + header.table_offset );
+	}
+
+	bool SequenceFileReader::GetPayloadSizes ( const SequenceFrameEntry & entry , std::size_t & color_size , std::size_t & depth_size ) const {
+
+		const std::size_t size = file_->size ( );
+
+		if ( !GetMatByteSize ( entry.color_rows , entry.color_cols , entry.color_type , color_size ) ) {
+			return false;
+		}
+
+		if ( entry.flags & kSequenceFrameDepthEncoded ) {
+
+			if ( entry.depth_offset >= size ) {
+				return false;
+			}
+
+			depth_size = GetEncodedDepthImageSize ( reinterpret_cast < const uchar * > ( file_->const_data ( ) ) + entry.depth_offset ,
+			                                        size - entry.depth_offset );
+
+		} else if ( !GetMatByteSize ( entry.depth_rows , entry.depth_cols , entry.depth_type , depth_size ) ) {
+			return false;
+		}
+
+		// Compared with the bytes left, offset + payload size could wrap
+		return entry.color_offset <= size and color_size <= size - entry.color_offset and
+		       entry.depth_offset <= size and depth_size <= size - entry.depth_offset;
+	}
+
+	const SequenceFrameEntry & SequenceFileReader::GetEntry ( int index ) const {
+
+		assert ( IsOpen ( ) and 0 <= index and index < frame_count_ );
+		return table_[ index ];
+	}
+
+	std::string SequenceFileReader::GetFrameName ( int index ) const {
+
+		namespace fs = boost::filesystem;
+
+		const SequenceFrameEntry & entry = GetEntry ( index );
+		const std::string name ( entry.name , strnlen ( entry.name , sizeof ( entry.name ) ) );
+
+		const fs::path path ( name_ );
+
+		if ( name.empty ( ) ) {
+			return ( path.parent_path ( ) / path.stem ( ) ).string ( ) + "_" + std::to_string ( index );
+		}
+
+		return ( path.parent_path ( ) / name ).string ( );
+	}
+
+	RawDataFrame SequenceFileReader::GetFrame ( int index , bool decode_depth ) const {
+
+		RawDataFrame frame;
+
+		if ( !IsOpen ( ) or index < 0 or index >= frame_count_ ) {
+			return frame;
+		}
+
+		const SequenceFrameEntry & entry = GetEntry ( index );
+
+		std::size_t color_size , depth_size;
+
+		if ( !GetPayloadSizes ( entry , color_size , depth_size ) ) {
+			std::cout << "Truncated frame " << index << " in : " << name_ << std::endl;
+			return frame;
+		}
+
+		char * data = file_->data ( );
+
+		if ( color_size > 0 ) {
+			frame.color_image = cv::Mat ( entry.color_rows , entry.color_cols , entry.color_type , data + entry.color_offset );
+		}
+		if ( ( entry.flags & kSequenceFrameDepthEncoded ) and !decode_depth ) {
+
+			// Only the mapping is kept, the decoded images come and go with their keyframes
+			const auto        file   = file_;
+			const std::size_t offset = entry.depth_offset;
+
+			frame.decode_depth = [ file , offset , depth_size ] ( RawDataFrame::DepthImage & depth_image ) {
+
+				return DecodeDepthImage ( reinterpret_cast < const uchar * > ( file->data ( ) + offset ) , depth_size , depth_image );
+			};
+			frame.encoded_depth_size = cv::Size ( entry.depth_cols , entry.depth_rows );
+
+		} else if ( entry.flags & kSequenceFrameDepthEncoded ) {
+
+			cv::Mat_ < ushort > depth_image;
+
+			// A corrupt depth block fails the frame as a truncated one does
+			if ( !DecodeDepthImage ( reinterpret_cast < const uchar * > ( data + entry.depth_offset ) , depth_size , depth_image ) ) {
+				std::cout << "Corrupt frame " << index << " in : " << name_ << std::endl;
+				return RawDataFrame ( );
+			}
+
+			frame.depth_image = depth_image;
+		} else if ( depth_size > 0 ) {
+			frame.depth_image = cv::Mat ( entry.depth_rows , entry.depth_cols , entry.depth_type , data + entry.depth_offset );
+		}
+
+		frame.name    = GetFrameName ( index );
+		frame.id      = index;
+		frame.storage = file_;
+
+		return frame;
+	}
+
+	void SequenceFileReader::Prefetch ( int index ) const {
+
+		if ( !IsOpen ( ) or index < 0 or index >= frame_count_ ) {
+			return;
+		}
+
+		const SequenceFrameEntry & entry = GetEntry ( index );
+
+		std::size_t color_size , depth_size;
+
+		if ( GetPayloadSizes ( entry , color_size , depth_size ) ) {
+			PrefetchMappedRange ( file_->const_data ( ) , entry.color_offset , entry.depth_offset + depth_size );
+		}
+	}
+
+	//----------------------------------------------
+	// Writer
+
+	SequenceFileWriter::SequenceFileWriter ( const std::string & file_name , bool encode_depth ) :
+			out_ ( file_name , std::ios::binary ) ,
+			encode_depth_ ( encode_depth ) ,
+			closed_ ( false ) {
+
+		if ( out_ ) {
+
+			// Placeholder, the final header is written by Close
+			SequenceFileHeader header;
+			std::memset ( & header , 0 , sizeof ( header ) );
+			out_.write ( reinterpret_cast < const char * > ( & header ) , sizeof ( header ) );
+		}
+	}
+
+	SequenceFileWriter::~SequenceFileWriter ( ) {
+
+		Close ( );
+	}
+
+	void SequenceFileWriter::Pad ( ) {
+
+		const std::uint64_t position = static_cast < std::uint64_t > ( out_.tellp ( ) );
+		const std::uint64_t padding  = ( kSequencePayloadAlignment - position % kSequencePayloadAlignment ) % kSequencePayloadAlignment;
+
+		const std::vector < char > zeros ( padding , 0 );
+		out_.write ( zeros.data ( ) , zeros.size ( ) );
+	}
+
+	bool SequenceFileWriter::Append ( const RawDataFrame & frame ) {
+
+		if ( !out_ or closed_ ) {
+			return false;
+		}
+
+		// Payloads are written row by row, the images may be ROIs of bigger ones.
+		auto write_image = [ this ] ( const cv::Mat & image , std::uint64_t & offset ,
+		                              std::int32_t & rows , std::int32_t & cols , std::int32_t & type ) {
+
+			Pad ( );
+
+			offset = static_cast < std::uint64_t > ( out_.tellp ( ) );
+			rows   = image.rows;
+			cols   = image.cols;
+			type   = image.type ( );
+
+			for ( auto row = 0 ; row < image.rows ; ++row ) {
+				out_.write ( reinterpret_cast < const char * > ( image.ptr ( row ) ) , image.cols * image.elemSize ( ) );
+			}
+		};
+
+		SequenceFrameEntry entry;
+		std::memset ( & entry , 0 , sizeof ( entry ) );
+
+		entry.id = static_cast < std::int32_t > ( table_.size ( ) );
+
+		const std::string name = boost::filesystem::path ( frame.name ).filename ( ).string ( );
+
+		// The name gives the file name of the frame when it is exported, a cut one would not
+		if ( name.size ( ) >= sizeof ( entry.name ) ) {
+			std::cout << "Frame name too long for a sequence file : " << name << std::endl;
+			return false;
+		}
+
+		std::strncpy ( entry.name , name.c_str ( ) , sizeof ( entry.name ) - 1 );
+
+		write_image ( frame.color_image , entry.color_offset , entry.color_rows , entry.color_cols , entry.color_type );
+
+		if ( encode_depth_ and frame.depth_image.type ( ) == CV_16UC1 ) {
+
+			Pad ( );
+
+			const std::vector < uchar > encoded = EncodeDepthImage ( frame.depth_image );
+
+			entry.flags |= kSequenceFrameDepthEncoded;
+			entry.depth_offset = static_cast < std::uint64_t > ( out_.tellp ( ) );
+			entry.depth_rows   = frame.depth_image.rows;
+			entry.depth_cols   = frame.depth_image.cols;
+			entry.depth_type   = CV_16UC1;
+
+			out_.write ( reinterpret_cast < const char * > ( encoded.data ( ) ) , encoded.size ( ) );
+
+		} else {
+
+			write_image ( frame.depth_image , entry.depth_offset , entry.depth_rows , entry.depth_cols , entry.depth_type );
+		}
+
+		if ( !out_ ) {
+			return false;
+		}
+
+		table_.push_back ( entry );
+
+		return true;
+	}
+
+	bool SequenceFileWriter::Close ( ) {
+
+		if ( !out_ or closed_ ) {
+			return false;
+		}
+
+		closed_ = true;
+
+		Pad ( );
+
+		SequenceFileHeader header;
+		std::memset ( & header , 0 , sizeof ( header ) );
+		std::memcpy ( header.magic , kSequenceFileMagic , sizeof ( header.magic ) );
+		header.version      = kSequenceFileVersion;
+		header.frame_count  = static_cast < std::int32_t > ( table_.size ( ) );
+		header.table_offset = static_cast < std::uint64_t > ( out_.tellp ( ) );
+
+		if ( !table_.empty ( ) ) {
+			out_.write ( reinterpret_cast < const char * > ( table_.data ( ) ) , sizeof ( SequenceFrameEntry ) * table_.size ( ) );
+		}
+
+		out_.seekp ( 0 );
+		out_.write ( reinterpret_cast < const char * > ( & header ) , sizeof ( header ) );
+		out_.close ( );
+
+		return !out_.fail ( );
+	}
+
+	//----------------------------------------------
+	// Import / Export
+
+	int ImportRawDataDirectory ( const std::string & dir_path , const std::string & sequence_file_name , bool encode_depth ) {
+
+		const RawDataFrames frames = MapRawDataDirectory ( dir_path );
+
+		SequenceFileWriter writer ( sequence_file_name , encode_depth );
+
+		if ( !writer.IsOpen ( ) ) {
+			std::cout << "File open failed : " << sequence_file_name << std::endl;
+			return 0;
+		}
+
+		int count = 0;
+
+		for ( const auto & frame : frames ) {
+			if ( writer.Append ( frame ) ) {
+				++count;
+			}
+		}
+
+		return writer.Close ( ) ? count : 0;
+	}
+
+	int ExportRawDataDirectory ( const std::string & sequence_file_name , const std::string & dir_path , bool encode_depth ) {
+
+		namespace fs = boost::filesystem;
+
+		const SequenceFileReader reader ( sequence_file_name );
+
+		if ( !reader.IsOpen ( ) ) {
+			return 0;
+		}
+
+		fs::create_directories ( dir_path );
+
+		int count = 0;
+
+		for ( auto i = 0 ; i < reader.GetFrameCount ( ) ; ++i ) {
+
+			const RawDataFrame frame = reader.GetFrame ( i );
+
+			std::string name = fs::path ( frame.name ).filename ( ).string ( );
+			if ( fs::path ( name ).extension ( ) != ".dat" ) {
+				name += ".dat";
+			}
+
+			std::ofstream out ( ( fs::path ( dir_path ) / name ).string ( ) , std::ios::binary );
+
+			if ( out ) {
+				WriteRawDataFrames ( out , RawDataFrames ( 1 , frame ) ,
+				                     encode_depth ? kRawDataFrameVersion | kRawDataFrameDepthCodecFlag : kRawDataFrameVersion );
+				++count;
+			}
+		}
+
+		return count;
+	}
+
+	int EncodeRawDataDirectory ( const std::string & dir_path , const std::string & output_dir_path ) {
+
+		namespace fs = boost::filesystem;
+
+		fs::create_directories ( output_dir_path );
+
+		int count = 0;
+
+		for ( const auto & frame : MapRawDataDirectory ( dir_path ) ) {
+
+			std::ofstream out ( ( fs::path ( output_dir_path ) / fs::path ( frame.name ).filename ( ) ).string ( ) , std::ios::binary );
+
+			if ( out ) {
+				WriteRawDataFrames ( out , RawDataFrames ( 1 , frame ) , kRawDataFrameVersion | kRawDataFrameDepthCodecFlag );
+				++count;
+			}
+		}
+
+		return count;
+	}
+
+}
@@ -8,10 +8,17 @@
 #include <QThread>
 #include <QtConcurrent>
 
+#include <algorithm>
 #include <vector>
 
+#include <Core/FeatureExtractor.h>
+#include <Core/FeatureStore.h>
+#include <Core/FramePool.h>
+#include <Core/Image.h>
 #include <Core/Utility.h>
 #include <Core/Serialize.h>
+#include <Core/MappedRawData.h>
+#include <Core/SequenceFile.h>
 
 #include <SLAM/CoordinateConverter.h>
 
@@ -20,20 +27,40 @@
 
 namespace NiS {
 
-	const float ImageHandler2::XtionFrameProperty::kXtionHorizontalFOV = 1.0225999f;
-	const float ImageHandler2::XtionFrameProperty::kXtionVerticalFOV   = 0.79661566f;
-	const float ImageHandler2::XtionFrameProperty::kXtionWidth         = 640;
-	const float ImageHandler2::XtionFrameProperty::kXtionHeight        = 480;
+	NiS::RawDataFrame ImageHandler2::ReadFrame ( const QString & file_name , int index ) {
 
+		RawDataFrame frame;
+
+		if ( IsSequenceFile ( file_name.toStdString ( ) ) ) {
 
-	NiS::RawDataFrame ImageHandler2::ReadFrame ( const QString & file_name ) {
+			frame    = SequenceFileReader ( file_name.toStdString ( ) ).GetFrame ( index );
+			frame.id = -1;
+
+			return frame;
+		}
+
+		ifstream in ( file_name.toStdString ( ) , ios::binary );
+		if ( in ) {
+
+			RawDataFileInfo info;
+
+			// Only the headers of the frames before index are read, repeated reads go through a probed info
+			frame      = NiS::ReadFrameAt ( in , index , info );
+			frame.name = file_name.toStdString ( );
+			frame.id   = -1;
+		}
+
+		return frame;
+	}
+
+	NiS::RawDataFrame ImageHandler2::ReadFrame ( const QString & file_name , const RawDataFileInfo & info , int index ) {
 
 		RawDataFrame frame;
 
 		ifstream in ( file_name.toStdString ( ) , ios::binary );
 		if ( in ) {
 
-			frame = ( NiS::Read < RawDataFrames > ( in ) )[ 0 ];
+			frame      = NiS::ReadFrameAt ( in , info , index );
 			frame.name = file_name.toStdString ( );
 			frame.id   = -1;
 		}
@@ -57,36 +84,117 @@ namespace NiS {
 
 		raw_data_frames_.clear ( );
 
+		// One task per frame : a .dat file gives its first frame, a .seq file all of its frames.
+		struct ReadTask
+		{
+			int                                         file;
+			std::shared_ptr < const SequenceFileReader > sequence;
+			int                                         frame;
+		};
+
+		std::vector < ReadTask > tasks;
+
 		for ( auto i = 0 ; i < file_list_.size ( ) ; ++i ) {
 
-			string std_path = file_list_[ i ].absoluteFilePath ( ).toStdString ( );
+			const string std_path = file_list_[ i ].absoluteFilePath ( ).toStdString ( );
+
+			if ( IsSequenceFile ( std_path ) ) {
+
+				auto sequence = std::make_shared < SequenceFileReader > ( std_path );
+
+				for ( auto frame = 0 ; frame < sequence->GetFrameCount ( ) ; ++frame ) {
+					tasks.push_back ( ReadTask { i , sequence , frame } );
+				}
+
+			} else {
+
+				tasks.push_back ( ReadTask { i , nullptr , 0 } );
+			}
+		}
 
-			ifstream in ( std_path , ios::binary );
+		const int task_count = static_cast < int > ( tasks.size ( ) );
 
-			if ( in ) {
+		// Frames are read by the worker threads one batch at a time, so that no more than
+		// a batch of frames is in flight. Results go to a slot per frame, which keeps
+		// the frames in file_list_ order whatever order the workers finish in.
+		const int batch_size = std::max ( QThreadPool::globalInstance ( )->maxThreadCount ( ) , 1 ) * 2;
 
-				RawDataFrame raw_data_frame = ( NiS::Read < RawDataFrames > ( in ) )[ 0 ];
+		std::vector < RawDataFrame > frames ( static_cast < size_t > ( task_count ) );
+		std::vector < char >         valid ( static_cast < size_t > ( task_count ) , 0 );
 
-				raw_data_frame.id   = i;
-				raw_data_frame.name = std_path;
+		auto read_frame = [ this , &tasks , &frames , &valid ] ( int i ) {
 
-				raw_data_frames_.push_back ( raw_data_frame );
+			const ReadTask & task = tasks[ i ];
 
-				std::cout << "Reading - id : " << raw_data_frame.id << ", name : " << raw_data_frame.name << std::endl;
+			if ( task.sequence ) {
 
-				emit Message ( file_list_[ i ].absoluteFilePath ( ) );
+				// Streaming mode only touches the pages of a frame when its images are restored.
+				if ( !streaming_ ) {
+					task.sequence->Prefetch ( task.frame );
+				}
 
-				in.close ( );
+				// Streaming mode keeps encoded depth encoded, it is decoded when a keyframe needs it
+				frames[ i ]    = task.sequence->GetFrame ( task.frame , !streaming_ );
+				frames[ i ].id = i;
+				valid[ i ]     = frames[ i ].HasDepth ( );
+
+				return;
+			}
+
+			string std_path = file_list_[ task.file ].absoluteFilePath ( ).toStdString ( );
+
+			// Images refer to the mapped file, nothing is copied here.
+			MappedRawDataFile file ( std_path );
+
+			if ( file.IsOpen ( ) and file.GetFrameCount ( ) > 0 ) {
+
+				if ( !streaming_ ) {
+					file.Prefetch ( 0 );
+				}
+
+				frames[ i ]      = file.GetFrame ( 0 , !streaming_ );
+				frames[ i ].id   = i;
+				frames[ i ].name = std_path;
+				valid[ i ]       = 1;
 
 			} else {
 
 				std::cout << "File open failed : " << std_path << endl;
 			}
+		};
+
+		for ( auto begin = 0 ; begin < task_count ; begin += batch_size ) {
+
+			const int end = std::min ( begin + batch_size , task_count );
+
+			QVector < int > indices;
+			for ( auto i = begin ; i < end ; ++i ) {
+				indices.push_back ( i );
+			}
 
+			QtConcurrent::blockingMap ( indices , [ & ] ( int i ) { read_frame ( i ); } );
+
+			emit Message ( QString ( "Reading ... %1 / %2" ).arg ( end ).arg ( task_count ) );
 		}
 
-		emit Message ( QString ( "Done reading %1 frames. (used %2)" )
+		raw_data_frames_.reserve ( static_cast < size_t > ( task_count ) );
+
+		for ( auto i = 0 ; i < task_count ; ++i ) {
+
+			if ( valid[ i ] ) {
+
+				raw_data_frames_.push_back ( frames[ i ] );
+
+				std::cout << "Reading - id : " << frames[ i ].id << ", name : " << frames[ i ].name << std::endl;
+			}
+		}
+
+		UpdateFrameSize ( );
+
+		emit Message ( QString ( "Done reading %1 frames of %2 x %3. (used %4)" )
 				               .arg ( raw_data_frames_.size ( ) )
+				               .arg ( frame_size_.width )
+				               .arg ( frame_size_.height )
 				               .arg ( ConvertTime ( timer.elapsed ( ) ) ) );
 
 		emit DoneReading ( );
@@ -98,21 +206,30 @@ namespace NiS {
 
 		keyframes_.clear ( );
 
-		for ( auto i = 0 ; i < raw_data_frames_.size ( ) ; ++i ) {
-			KeyFrame kf;
-			kf.SetId ( raw_data_frames_[ i ].id );
-			kf.SetName ( raw_data_frames_[ i ].name );
-			kf.SetColorImage ( raw_data_frames_[ i ].color_image );
-			kf.SetPointImage ( std::move ( ConvertDepthImageToPointImage ( raw_data_frames_[ i ].depth_image , choice ) ) );
-
-			keyframes_.push_back ( kf );
+		calibrated_ = false;
 
-			std::cout << "Converted (" << choice << ")." << i << std::endl;
+		std::shared_ptr < const CoordinateConverter > converter;
+		std::shared_ptr < const DepthRegistration >   registration = registration_;
+		switch ( choice ) {
+			case 0:
+				converter = std::make_shared < XtionCoordinateConverter > ( xtion_converter_ );
+				break;
+			case 1:
+				converter    = std::make_shared < AistCoordinateConverter > ( aist_converter_ );
+				registration = GetCalibratedRegistration ( "AIST" );
+				break;
+			default:
+				break;
+		}
 
-			emit Message (
-					QString ( "Converted %1. KP size : %2" ).arg ( kf.GetId ( ) ).arg ( kf.GetFeature ( ).GetKeyPoints ( ).size ( ) ) );
+		point_images_.reset ( );
+		if ( converter ) {
+			point_images_ = std::make_shared < PointImageCache > ( std::make_shared < CoordinateDepthConverter > ( converter ) ,
+			                                                     PointImageCache::kDefaultCapacity , compact_point_images_ );
 		}
 
+		ConvertFrames ( "" , registration );
+
 		emit SendData ( keyframes_ );
 	}
 
@@ -126,52 +243,224 @@ namespace NiS {
 
 			keyframes_.clear ( );
 
-			for ( auto i = 0 ; i < raw_data_frames_.size ( ) ; ++i ) {
+			point_images_ = std::make_shared < PointImageCache > ( std::make_shared < CalibratedDepthConverter > ( calibrator_ ) ,
+			                                                     PointImageCache::kDefaultCapacity , compact_point_images_ );
+
+			ConvertFrames ( " (Calibrated)" , GetCalibratedRegistration ( "calibrated" ) );
+
+			emit SendData ( keyframes_ );
+		}
+	}
+
+	void ImageHandler2::ConvertFrames ( const QString & label , std::shared_ptr < const DepthRegistration > registration ) {
+
+		QTime timer;
+		timer.start ( );
+
+		converted_registration_ = registration;
+
+		const int frame_count = static_cast < int > ( raw_data_frames_.size ( ) );
+
+		// A slot per frame keeps the keyframes in raw_data_frames_ (id) order
+		keyframes_.assign ( static_cast < size_t > ( frame_count ) , KeyFrame ( ) );
 
-				KeyFrame kf;
+		std::vector < char > stored ( static_cast < size_t > ( frame_count ) , 0 );
+
+		// Only the depth prefilter reads the registered depth, the key points are detected in the color images
+		const std::uint64_t registration_hash = detection_parameters_.IsDepthFiltered ( ) ? registration->Hash ( ) : 0;
+		const std::uint64_t parameters        = ScaledFeatureParameters ( RegisteredFeatureParameters ( detection_parameters_.Hash ( ) , registration_hash ) ,
+		                                                             static_cast < int > ( processing_scale_ ) );
+
+		// Frames go through the stages one batch at a time, each stage runs on all the cores.
+		// Dense point images are not part of it, the cache computes them when they are used (display, export).
+		const int batch_size = std::max ( QThreadPool::globalInstance ( )->maxThreadCount ( ) , 1 ) * 2;
+
+		for ( auto begin = 0 ; begin < frame_count ; begin += batch_size ) {
+
+			const int end = std::min ( begin + batch_size , frame_count );
+
+			QVector < int > indices;
+
+			for ( auto i = begin ; i < end ; ++i ) {
+
+				KeyFrame & kf = keyframes_[ i ];
 				kf.SetId ( raw_data_frames_[ i ].id );
 				kf.SetName ( raw_data_frames_[ i ].name );
 				kf.SetColorImage ( raw_data_frames_[ i ].color_image );
-				kf.SetPointImage ( calibrator_.CalibrateImage ( raw_data_frames_[ i ].depth_image ) );
+				kf.SetDepthImage ( raw_data_frames_[ i ].depth_image , point_images_ );
+				kf.SetImageStorage ( raw_data_frames_[ i ].storage );
+				kf.SetDetectionParameters ( detection_parameters_ );
+				kf.SetFeatureParameters ( parameters );
+
+				indices.push_back ( i );
+			}
 
-				keyframes_.push_back ( kf );
+			// Depth in the color frame (the key points index it), images at the processing scale and encoded depth
+			// decoded (streaming mode)
+			if ( !registration->IsIdentity ( ) or processing_scale_ != ProcessingScale::Full or streaming_ ) {
+				QtConcurrent::blockingMap ( indices , [ & ] ( int i ) {
 
-				emit Message ( QString ( "Converted %1 (Calibrated). KP size : %2" )
-						               .arg ( kf.GetId ( ) )
-						               .arg ( kf.GetFeature ( ).GetKeyPoints ( ).size ( ) ) );
+					ColorImage color_image;
+					DepthImage depth_image;
+					PrepareImages ( raw_data_frames_[ i ] , color_image , depth_image );
+
+					keyframes_[ i ].SetColorImage ( color_image , keyframes_[ i ].GetFeatureType ( ) );
+					keyframes_[ i ].SetDepthImage ( depth_image , point_images_ );
+				} );
 			}
 
-			emit SendData ( keyframes_ );
+			// Features of the store (or of former .feature files)
+			QtConcurrent::blockingMap ( indices , [ & ] ( int i ) { stored[ i ] = keyframes_[ i ].LoadStoredFeature ( ); } );
+
+			QVector < int > missing;
+
+			for ( auto i : indices ) {
+				if ( !stored[ i ] ) {
+					missing.push_back ( i );
+				}
+			}
+
+			// Features of the others, the keyframes of a dataset share the feature type
+			if ( !missing.empty ( ) ) {
+
+				QVector < int > positions;
+
+				for ( auto k = 0 ; k < missing.size ( ) ; ++k ) {
+					positions.push_back ( k );
+				}
+
+				std::vector < cv::Mat_ < uchar > >  gray_images ( static_cast < size_t > ( missing.size ( ) ) );
+				std::vector < cv::Mat_ < ushort > > depth_images;
+
+				QtConcurrent::blockingMap ( positions , [ & ] ( int k ) { gray_images[ k ] = keyframes_[ missing[ k ] ].GetGrayImage ( ); } );
+
+				// Key points without a usable point are dropped before their descriptors
+				for ( auto i : missing ) {
+					depth_images.push_back ( keyframes_[ i ].GetDepthImage ( ) );
+				}
+
+				const FeatureExtractor        extractor ( keyframes_[ missing.front ( ) ].GetFeatureType ( ) , detection_parameters_ );
+				const std::vector < Feature > features = extractor.Extract ( gray_images , depth_images );
+
+				gray_images.clear ( );
+				depth_images.clear ( );
+
+				QtConcurrent::blockingMap ( positions , [ & ] ( int k ) { keyframes_[ missing[ k ] ].SetExtractedFeature ( features[ k ] ); } );
+			}
+
+			// 3D points of the key points, the tracker works from them without the images
+			QtConcurrent::blockingMap ( indices , [ & ] ( int i ) { keyframes_[ i ].ComputeKeyPointPoints ( ); } );
+
+			if ( streaming_ ) {
+				for ( auto i : indices ) {
+					keyframes_[ i ].ReleaseImages ( );
+				}
+			}
+
+			std::cout << "Converted" << label.toStdString ( ) << " " << end << " / " << frame_count
+			          << " (extracted " << missing.size ( ) << ")" << std::endl;
+
+			emit Message ( QString ( "Converted%1 %2 / %3" ).arg ( label ).arg ( end ).arg ( frame_count ) );
 		}
+
+		FlushFeatureStores ( );
+
+		const FramePoolStatistics pool = FramePool::Instance ( ).GetStatistics ( );
+
+		std::cout << "Frame pool - hits : " << pool.hits << ", misses : " << pool.misses
+		          << ", recycled : " << pool.recycled << ", dropped : " << pool.dropped
+		          << ", cached : " << pool.cached_bytes / ( 1024 * 1024 ) << " MB" << std::endl;
+
+		emit Message ( QString ( "Done converting %1 frames%2. (used %3, frame buffers reused %4 / %5)" )
+				               .arg ( frame_count )
+				               .arg ( label )
+				               .arg ( ConvertTime ( timer.elapsed ( ) ) )
+				               .arg ( pool.hits )
+				               .arg ( pool.hits + pool.misses ) );
 	}
 
-	PointImage ImageHandler2::ConvertDepthImageToPointImage ( DepthImage const & depth_image , int choice ) {
+	void ImageHandler2::LoadKeyFrame ( KeyFrame & keyframe ) const {
 
-		const CoordinateConverter * converter;
-		switch ( choice ) {
-			case 0:
-				converter = & xtion_converter_;
-				break;
-			case 1:
-				converter = & aist_converter_;
-				break;
-			default:
-				return PointImage ( );
+		// raw_data_frames_ is sorted by id
+		auto itr = std::lower_bound ( raw_data_frames_.begin ( ) , raw_data_frames_.end ( ) , keyframe.GetId ( ) ,
+		                              [ ] ( const RawDataFrame & frame , int id ) { return frame.id < id; } );
+
+		if ( itr == raw_data_frames_.end ( ) or itr->id != keyframe.GetId ( ) ) {
+			std::cout << "No raw data for keyframe : " << keyframe.GetId ( ) << std::endl;
+			return;
 		}
 
-		PointImage point_image;
-		point_image.create ( depth_image.rows , depth_image.cols );
+		ColorImage color_image;
+		DepthImage depth_image;
+		PrepareImages ( * itr , color_image , depth_image );
+
+		keyframe.RestoreImages ( color_image , depth_image , itr->storage );
+	}
+
+	void ImageHandler2::PrepareImages ( const RawDataFrame & frame , ColorImage & color_image , DepthImage & depth_image ) const {
+
+		color_image = frame.color_image;
+		depth_image = converted_registration_->Register ( frame.GetDepthImage ( ) );
+
+		const int scale = static_cast < int > ( processing_scale_ );
+
+		if ( scale > 1 ) {
+
+			// Colors are averaged, depths are sampled : averages would mix the depths of both sides of the edges
+			color_image = Resize ( color_image , color_image.cols / scale , color_image.rows / scale , cv::INTER_AREA );
+			depth_image = Resize ( depth_image , depth_image.cols / scale , depth_image.rows / scale , cv::INTER_NEAREST );
+		}
+	}
+
+	std::shared_ptr < const DepthRegistration > ImageHandler2::GetCalibratedRegistration ( const QString & label ) {
+
+		// Their calibration is per depth pixel, registered depth images are in the color frame. The registration
+		// stays set for the next Xtion conversion.
+		if ( !registration_->IsIdentity ( ) ) {
 
-		for ( auto row = 0 ; row < depth_image.rows ; ++row ) {
-			for ( auto col = 0 ; col < depth_image.cols ; ++col ) {
-				cv::Point3f p = converter->ScreenToWorld ( ScreenPoint ( col , row ) , depth_image.at < ushort > ( row , col ) );
+			std::cout << "Depth registration not used by the " << label.toStdString ( ) << " conversion" << std::endl;
 
-				point_image.at < cv::Vec3f > ( row , col ) ( 0 ) = p.x;
-				point_image.at < cv::Vec3f > ( row , col ) ( 1 ) = p.y;
-				point_image.at < cv::Vec3f > ( row , col ) ( 2 ) = p.z;
+			emit Message ( QString ( "Depth registration not used : the %1 conversion works on the depth camera images" ).arg ( label ) );
+		}
+
+		return std::make_shared < DepthRegistration > ( );
+	}
+
+	void ImageHandler2::UpdateFrameSize ( ) {
+
+		if ( raw_data_frames_.empty ( ) ) {
+			return;
+		}
+
+		const int      scale = static_cast < int > ( processing_scale_ );
+		const cv::Size depth = raw_data_frames_.front ( ).GetDepthSize ( );
+		const cv::Size color = raw_data_frames_.front ( ).color_image.size ( );
+
+		// The converters, the calibrator and the point image cache work at one size : other frames are dropped
+		RawDataFrames frames;
+		frames.reserve ( raw_data_frames_.size ( ) );
+
+		for ( const auto & frame : raw_data_frames_ ) {
+
+			if ( frame.GetDepthSize ( ) == depth and frame.color_image.size ( ) == color ) {
+				frames.push_back ( frame );
+			} else {
+				std::cout << "Frame size differs from the first frame, not used : " << frame.name << std::endl;
 			}
 		}
-		return point_image;
+
+		if ( frames.size ( ) < raw_data_frames_.size ( ) ) {
+			emit Message ( QString ( "%1 frames of another size than the first one are not used" )
+					               .arg ( raw_data_frames_.size ( ) - frames.size ( ) ) );
+		}
+
+		raw_data_frames_.swap ( frames );
+
+		frame_size_ = cv::Size ( depth.width / scale , depth.height / scale );
+
+		xtion_converter_.SetFrameSize ( frame_size_ );
+		aist_converter_.SetFrameSize ( frame_size_ );
+		calibrator_.SetFrameSize ( frame_size_ );
 	}
 
 }
@@ -26,6 +26,22 @@ namespace NiS {
 
             options_.UseBundleAdjustment(ui_.CheckBox_UseBundleAdjustment->isChecked());
 
+            if (ui_.CheckBox_BucketedDetection->isChecked()) {
+                options_.options_detection = DetectionParameters(ui_.SpinBox_GridColumns->value(),
+                                                                 ui_.SpinBox_GridRows->value(),
+                                                                 ui_.SpinBox_KeyPointsPerCell->value(),
+                                                                 ui_.SpinBox_KeyPointsPerFrame->value());
+            } else {
+                options_.options_detection = DetectionParameters();
+            }
+
+            if (ui_.CheckBox_DepthFilter->isChecked()) {
+                options_.options_detection.depth_filter_radius = DetectionParameters::kDepthFilterRadius;
+                options_.options_detection.max_depth_step = static_cast<float>(ui_.DoubleSpinBox_MaxDepthStep->value());
+            } else {
+                options_.options_detection.depth_filter_radius = -1;
+            }
+
             QDialog::accept();
         }
 
@@ -7,7 +7,9 @@
 
 #include <SLAM/Tracker.h>
 #include <SLAM/CoordinateConverter.h>
+#include <SLAM/DepthRegistration.h>
 
+#include <QActionGroup>
 #include <QMessageBox>
 #include <QMouseEvent>
 #include <QFileDialog>
@@ -36,9 +38,15 @@ namespace NiS {
 		inliers_viewer_option_dialog_->setModal ( false );
 
 		ui_.actionOpenInliersViewMode->setChecked ( false );
+
+		QActionGroup * processing_scale_group = new QActionGroup ( this );
+		processing_scale_group->addAction ( ui_.actionProcessingScaleFull );
+		processing_scale_group->addAction ( ui_.actionProcessingScaleHalf );
+		processing_scale_group->addAction ( ui_.actionProcessingScaleQuarter );
 		ui_.Frame_ControlPanel->hide ( );
 		ui_.actionStartSlamComputation->setEnabled ( false );
 		ui_.actionInternalCalibration->setEnabled ( false );
+		ui_.actionOpenDepthRegistration->setEnabled ( false );
 		ui_.HorizontalSlider_PointCloudDensity->setEnabled ( false );
 		ui_.actionOpenInliersViewMode->setEnabled ( false );
 		ui_.actionCaptureModelMage->setEnabled ( false );
@@ -64,6 +72,7 @@ namespace NiS {
 		connect ( ui_.actionShowControlPanel , SIGNAL ( triggered ( ) ) , this , SLOT ( onActionShowControlPanel ( ) ) );
 		connect ( ui_.actionOpenLogPanel , SIGNAL ( triggered ( ) ) , this , SLOT ( onActionOpenLogPanel ( ) ) );
 		connect ( ui_.actionInternalCalibration , SIGNAL ( triggered ( ) ) , this , SLOT ( onActionInternalCalibration ( ) ) );
+		connect ( ui_.actionOpenDepthRegistration , SIGNAL ( triggered ( ) ) , this , SLOT ( onActionOpenDepthRegistrationFile ( ) ) );
 		connect ( ui_.actionOpenInliersViewMode , SIGNAL ( triggered ( bool ) ) , this ,
 		          SLOT ( onActionOpenInliersViewerMode ( bool ) ) );
 		connect ( ui_.actionCaptureModelMage , SIGNAL ( triggered ( bool ) ) , this , SLOT ( onActionCaptureModelImage ( ) ) );
@@ -125,7 +134,8 @@ namespace NiS {
 
 		computation_configured_ = true;
 
-		ui_.actionStartSlamComputation->setEnabled ( true );
+		// Configured before the conversion for its key point detection, the computation waits for the keyframes
+		ui_.actionStartSlamComputation->setEnabled ( !keyframes_.empty ( ) );
 
 	}
 
@@ -137,6 +147,8 @@ namespace NiS {
 	void MainWindow::OnReadingFinished ( ) {
 
 		ui_.actionInternalCalibration->setEnabled ( true );
+		ui_.actionOpenDepthRegistration->setEnabled ( true );
+		ui_.actionConfigureSlamComputation->setEnabled ( true );
 
 	}
 
@@ -156,6 +168,19 @@ namespace NiS {
 		ui_.actionUsePreviousResult->setEnabled ( true );
 		ui_.actionConfigureSlamComputation->setEnabled ( true );
 
+		// Streaming mode : the answers and the viewers restore the released images through the handler
+		if ( handler_->IsStreamingMode ( ) ) {
+
+			const ImageHandler2 * handler = handler_;
+			frame_loader_ = [ handler ] ( KeyFrame & keyframe ) { handler->LoadKeyFrame ( keyframe ); };
+		} else {
+
+			frame_loader_ = KeyFrameLoader ( );
+		}
+
+		computer_->SetFrameLoader ( frame_loader_ );
+		ui_.BasicViewer->SetFrameLoader ( frame_loader_ );
+
 		computer_->SetDataDir ( data_dir_ );
 		computer_->SetFrameData ( keyframes_ );
 	}
@@ -182,10 +207,15 @@ namespace NiS {
 
 			data_dir_          = QDir ( dir_path );
 
-			QStringList   name_filers ( QString ( "*.dat" ) );
-			QFileInfoList list = data_dir_.entryInfoList ( name_filers );
+			// A packed sequence replaces the per frame .dat files it was made from.
+			QFileInfoList list = data_dir_.entryInfoList ( QStringList ( QString ( "*.seq" ) ) );
+			if ( list.empty ( ) ) {
+				list = data_dir_.entryInfoList ( QStringList ( QString ( "*.dat" ) ) );
+			}
 
 			handler_ = new ImageHandler2 ( list , this );
+			handler_->SetStreamingMode ( ui_.actionStreamingMode->isChecked ( ) );
+			handler_->SetProcessingScale ( GetProcessingScale ( ) );
 
 			connect ( watcher_ , SIGNAL ( finished ( ) ) , this , SLOT ( OnReadingFinished ( ) ) );
 			connect ( handler_ , SIGNAL ( Message ( QString ) ) , log_panel_dialog_ , SLOT ( AppendMessage ( QString ) ) );
@@ -197,12 +227,25 @@ namespace NiS {
 		}
 	}
 
+	ProcessingScale MainWindow::GetProcessingScale ( ) const {
+
+		if ( ui_.actionProcessingScaleQuarter->isChecked ( ) ) {
+			return ProcessingScale::Quarter;
+		}
+
+		if ( ui_.actionProcessingScaleHalf->isChecked ( ) ) {
+			return ProcessingScale::Half;
+		}
+
+		return ProcessingScale::Full;
+	}
+
 	void MainWindow::onActionOpenInternalCalibrationFile ( ) {
 
 		QString path = QFileDialog::getOpenFileName ( this ,
 		                                              "Open Internal Calibration File" ,
 		                                              QDir::homePath ( ) ,
-		                                              "*.cal" );
+		                                              "*.cal *.fcal" );
 
 
 		if ( !path.isEmpty ( ) ) {
@@ -218,6 +261,25 @@ namespace NiS {
 
 	}
 
+	void MainWindow::onActionOpenDepthRegistrationFile ( ) {
+
+		QString path = QFileDialog::getOpenFileName ( this ,
+		                                              "Open Depth Registration File" ,
+		                                              QDir::homePath ( ) ,
+		                                              QString ( "*%1" ).arg ( QString::fromStdString ( DepthRegistration::kFileExtension ) ) );
+
+		if ( !path.isEmpty ( ) ) {
+
+			const DepthRegistration registration = DepthRegistration::Read ( path.toStdString ( ) );
+
+			handler_->SetDepthRegistration ( registration );
+
+			log_panel_dialog_->AppendMessage ( registration.IsIdentity ( ) ?
+			                                   QString ( "Depth registration file ignored (identity or unreadable) :\n%1" ).arg ( path ) :
+			                                   QString ( "Depth registration file loaded :\n%1" ).arg ( path ) );
+		}
+	}
+
 	void MainWindow::onActionInternalCalibration ( ) {
 
 		// ResetWatcher ( );
@@ -228,6 +290,8 @@ namespace NiS {
 
 		assert ( !handler_->GetRawDataFrames ( ).empty ( ) );
 
+		handler_->SetDetectionParameters ( computer_->GetOptions ( ).options_detection );
+
 		connect ( watcher_ , SIGNAL ( finished ( ) ) , this , SLOT ( OnConversionFinished ( ) ) );
 
 		CoordinateConverterDialog dialog;
@@ -354,6 +418,7 @@ namespace NiS {
 			          ui_.BasicViewer ,
 			          SLOT ( SetCorrespondingPoints ( CorrespondingPointsPair ) ) );
 
+			inliers_viewer_option_dialog_->SetFrameLoader ( frame_loader_ );
 			inliers_viewer_option_dialog_->SetKeyFrames ( keyframes_ );
 			inliers_viewer_option_dialog_->SetOptions ( computer_->GetOptions ( ) );
 
@@ -376,6 +441,11 @@ namespace NiS {
 			std::cout << computer_->GetOptions ( ).options_one_by_one.Output ( ).toStdString ( ) << std::endl;
 			std::cout << computer_->GetOptions ( ).options_pca_keyframe.Output ( ).toStdString ( ) << std::endl;
 			std::cout << computer_->GetOptions ( ).options_fixed_frame_count.Output ( ).toStdString ( ) << std::endl;
+			std::cout << computer_->GetOptions ( ).options_detection.Output ( ).toStdString ( ) << std::endl;
+
+			if ( !keyframes_.empty ( ) and computer_->GetOptions ( ).options_detection != handler_->GetDetectionParameters ( ) ) {
+				ui_.statusbar->showMessage ( "Key point detection changed, it applies to the next conversion." );
+			}
 
 			emit ConfigurationDone ( );
 		}
@@ -428,7 +498,7 @@ namespace NiS {
 
 		if ( !keyframes_.empty ( ) ) {
 			marker_viewer_dialog_->show ( );
-			marker_viewer_dialog_->SetKeyFrames ( keyframes_ );
+			marker_viewer_dialog_->SetKeyFrames ( keyframes_ , frame_loader_ );
 		}
 
 		else {
@@ -450,7 +520,7 @@ namespace NiS {
 
 			computer_->WriteResult ( );
 
-			marker_viewer_dialog_->SetKeyFrames ( keyframes_ );
+			marker_viewer_dialog_->SetKeyFrames ( keyframes_ , frame_loader_ );
 			int result = marker_viewer_dialog_->exec ( );
 
 			if ( result == QDialog::Accepted ) {
@@ -31,34 +31,34 @@ namespace NiS {
     void MarkerSelectorDialog::mousePressEvent(QMouseEvent *e) {
 
         if (ui_.Label_Image->rect().contains(e->pos())) {
-            const cv::Vec3f point = keyframe_.GetPointImage().at<cv::Vec3f>(e->y(), e->x());
-            ui_.LineEdit_ResultPointX->setText(QString("%1").arg(point(0)));
-            ui_.LineEdit_ResultPointY->setText(QString("%1").arg(point(1)));
-            ui_.LineEdit_ResultPointZ->setText(QString("%1").arg(point(2)));
+            const cv::Point3f point = keyframe_.GetPoint(e->y(), e->x());
+            ui_.LineEdit_ResultPointX->setText(QString("%1").arg(point.x));
+            ui_.LineEdit_ResultPointY->setText(QString("%1").arg(point.y));
+            ui_.LineEdit_ResultPointZ->setText(QString("%1").arg(point.z));
         }
     }
 
     void MarkerSelectorDialog::mouseMoveEvent(QMouseEvent *e) {
 
         if (ui_.Label_Image->geometry().contains(e->pos())) {
-            const cv::Vec3f point = keyframe_.GetPointImage().at<cv::Vec3f>(e->y(), e->x());
-            ui_.LineEdit_MousePositionX->setText(QString("%1").arg(point(0)));
-            ui_.LineEdit_MousePositionY->setText(QString("%1").arg(point(1)));
-            ui_.LineEdit_MousePositionZ->setText(QString("%1").arg(point(2)));
+            const cv::Point3f point = keyframe_.GetPoint(e->y(), e->x());
+            ui_.LineEdit_MousePositionX->setText(QString("%1").arg(point.x));
+            ui_.LineEdit_MousePositionY->setText(QString("%1").arg(point.y));
+            ui_.LineEdit_MousePositionZ->setText(QString("%1").arg(point.z));
         }
     }
 
     void MarkerSelectorDialog::mouseDoubleClickEvent(QMouseEvent *e) {
 
         if (ui_.Label_Image->geometry().contains(e->pos())) {
-            const cv::Vec3f point = keyframe_.GetPointImage().at<cv::Vec3f>(e->y(), e->x());
-            ui_.LineEdit_MousePositionX->setText(QString("%1").arg(point(0)));
-            ui_.LineEdit_MousePositionY->setText(QString("%1").arg(point(1)));
-            ui_.LineEdit_MousePositionZ->setText(QString("%1").arg(point(2)));
-
-            point_.x = point(0);
-            point_.y = point(1);
-            point_.z = point(2);
+            const cv::Point3f point = keyframe_.GetPoint(e->y(), e->x());
+            ui_.LineEdit_MousePositionX->setText(QString("%1").arg(point.x));
+            ui_.LineEdit_MousePositionY->setText(QString("%1").arg(point.y));
+            ui_.LineEdit_MousePositionZ->setText(QString("%1").arg(point.z));
+
+            point_.x = point.x;
+            point_.y = point.y;
+            point_.z = point.z;
 
             hide();
 
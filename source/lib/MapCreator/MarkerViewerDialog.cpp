@@ -10,10 +10,21 @@
 
 namespace NiS {
 
-	MarkerViewerDialog::MarkerViewerDialog ( QWidget * parent ) {
+	namespace {
+
+		// Images decoded ahead on each side of a slider position
+		const int kPrefetchRadius = 8;
+	}
+
+	MarkerViewerDialog::MarkerViewerDialog ( QWidget * parent ) :
+			prefetcher_ ( 4 * kPrefetchRadius + 2 ) ,
+			loading_index1_ ( -1 ) ,
+			loading_index2_ ( -1 ) {
 
 		ui_.setupUi ( this );
 
+		InitializePrefetcher ( );
+
 		setMouseTracking ( true );
 
 		dialog1_ = new MarkerSelectorDialog ( this );
@@ -27,10 +38,15 @@ namespace NiS {
 	}
 
 	MarkerViewerDialog::MarkerViewerDialog ( const KeyFrames & keyframes , QWidget * parent ) :
-			keyframes_ ( keyframes ) {
+			keyframes_ ( keyframes ) ,
+			prefetcher_ ( 4 * kPrefetchRadius + 2 ) ,
+			loading_index1_ ( -1 ) ,
+			loading_index2_ ( -1 ) {
 
 		ui_.setupUi ( this );
 
+		InitializePrefetcher ( );
+
 		SetKeyFrames ( keyframes );
 		setMouseTracking ( true );
 
@@ -41,9 +57,47 @@ namespace NiS {
 
 	}
 
-	void MarkerViewerDialog::SetKeyFrames ( const KeyFrames & keyframes ) {
+	void MarkerViewerDialog::SetKeyFrames ( const KeyFrames & keyframes , const KeyFrameLoader & frame_loader ) {
+
+		keyframes_    = keyframes;
+		frame_loader_ = frame_loader;
 
-		keyframes_ = keyframes;
+		// The loader runs on the prefetcher's threads, it only gets (shared) copies of the color images,
+		// and the ids of the frames released in streaming mode to restore them.
+		std::vector < ColorImage > color_images;
+		std::vector < int >        ids;
+		color_images.reserve ( keyframes_.size ( ) );
+		ids.reserve ( keyframes_.size ( ) );
+		for ( const auto & keyframe : keyframes_ ) {
+			color_images.push_back ( keyframe.GetColorImage ( ) );
+			ids.push_back ( keyframe.GetId ( ) );
+		}
+
+		const QSize size = ui_.Label_MarkerImage1->size ( );
+
+		prefetcher_.SetLoader ( [ color_images , ids , frame_loader , size ] ( int index ) -> QImage {
+
+			ColorImage color = color_images[ index ];
+
+			if ( color.empty ( ) and frame_loader ) {
+
+				KeyFrame keyframe;
+				keyframe.SetId ( ids[ index ] );
+				frame_loader ( keyframe );
+				color = keyframe.GetColorImage ( );
+			}
+
+			if ( color.empty ( ) ) {
+				return QImage ( );
+			}
+
+			// scaled makes a deep copy, the image does not refer to the color image anymore
+			return QImage ( color.data , color.cols , color.rows , static_cast < int > ( color.step ) , QImage::Format::Format_RGB888 )
+					.scaled ( size , Qt::KeepAspectRatio );
+		} );
+
+		loading_index1_ = -1;
+		loading_index2_ = -1;
 
 		ui_.HorizontalSlider_MarkerImage1->setRange ( 0 , keyframes_.size ( ) - 1 );
 		ui_.HorizontalSlider_MarkerImage2->setRange ( 0 , keyframes_.size ( ) - 1 );
@@ -72,27 +126,65 @@ namespace NiS {
 
 	void MarkerViewerDialog::SetImage1 ( int index ) {
 
-		ColorImage color = keyframes_[ index ].GetColorImage ( );
-		PointImage point = keyframes_[ index ].GetPointImage ( );
-
-		QImage display_image = QImage ( color.data , color.cols , color.rows , QImage::Format::Format_RGB888 );
-
-		ui_.Label_MarkerImage1->setPixmap ( QPixmap::fromImage ( display_image ).scaled ( ui_.Label_MarkerImage1->width ( ) ,
-		                                                                                  ui_.Label_MarkerImage1->height ( ) ,
-		                                                                                  Qt::KeepAspectRatio ) );
+		SetImage ( index , ui_.Label_MarkerImage1 , image_watcher1_ , loading_index1_ );
 		ui_.CheckBox_HasPoint1->setChecked ( false );
 	}
 
 	void MarkerViewerDialog::SetImage2 ( int index ) {
 
-		ColorImage color = keyframes_[ index ].GetColorImage ( );
-		PointImage point = keyframes_[ index ].GetPointImage ( );
+		SetImage ( index , ui_.Label_MarkerImage2 , image_watcher2_ , loading_index2_ );
+		ui_.CheckBox_HasPoint2->setChecked ( false );
+	}
 
-		QImage display_image = QImage ( color.data , color.cols , color.rows , QImage::Format::Format_RGB888 );
+	void MarkerViewerDialog::SetImage ( int index , QLabel * label , QFutureWatcher < QImage > & watcher , int & loading_index ) {
 
-		ui_.Label_MarkerImage2->setPixmap ( QPixmap::fromImage ( display_image ).scaled ( ui_.Label_MarkerImage2->width ( ) ,
-		                                                                                  ui_.Label_MarkerImage2->height ( ) , Qt::KeepAspectRatio ) );
-		ui_.CheckBox_HasPoint2->setChecked ( false );
+		if ( index < 0 or index >= static_cast < int > ( keyframes_.size ( ) ) ) {
+			return;
+		}
+
+		QFuture < QImage > future = prefetcher_.Request ( index );
+		prefetcher_.Prefetch ( index , kPrefetchRadius , static_cast < int > ( keyframes_.size ( ) ) );
+
+		if ( future.isFinished ( ) ) {
+
+			loading_index = -1;
+
+			if ( future.resultCount ( ) > 0 ) {
+				label->setPixmap ( QPixmap::fromImage ( future.result ( ) ) );
+			}
+
+		} else {
+
+			// Shown by onImage1Loaded / onImage2Loaded, unless the slider moves on in the meantime
+			loading_index = index;
+			watcher.setFuture ( future );
+		}
+	}
+
+	void MarkerViewerDialog::onImage1Loaded ( ) {
+
+		if ( loading_index1_ >= 0 and loading_index1_ == ui_.HorizontalSlider_MarkerImage1->value ( ) and
+		     image_watcher1_.future ( ).resultCount ( ) > 0 ) {
+			ui_.Label_MarkerImage1->setPixmap ( QPixmap::fromImage ( image_watcher1_.result ( ) ) );
+		}
+
+		loading_index1_ = -1;
+	}
+
+	void MarkerViewerDialog::onImage2Loaded ( ) {
+
+		if ( loading_index2_ >= 0 and loading_index2_ == ui_.HorizontalSlider_MarkerImage2->value ( ) and
+		     image_watcher2_.future ( ).resultCount ( ) > 0 ) {
+			ui_.Label_MarkerImage2->setPixmap ( QPixmap::fromImage ( image_watcher2_.result ( ) ) );
+		}
+
+		loading_index2_ = -1;
+	}
+
+	void MarkerViewerDialog::InitializePrefetcher ( ) {
+
+		connect ( & image_watcher1_ , SIGNAL( finished ( ) ) , this , SLOT( onImage1Loaded ( ) ) );
+		connect ( & image_watcher2_ , SIGNAL( finished ( ) ) , this , SLOT( onImage2Loaded ( ) ) );
 	}
 
 	void MarkerViewerDialog::InitializeConnections ( ) {
@@ -130,7 +222,7 @@ namespace NiS {
 		if ( ui_.Label_MarkerImage1->geometry ( ).contains ( e->pos ( ) ) ) {
 			int index = ui_.HorizontalSlider_MarkerImage1->value ( );
 
-			dialog1_->SetKeyFrame ( keyframes_[ index ] );
+			dialog1_->SetKeyFrame ( GetKeyFrameWithImages ( index ) );
 			dialog1_->exec ( );
 			point1_ = dialog1_->GetPoint ( );
 
@@ -139,13 +231,24 @@ namespace NiS {
 		else if ( ui_.Label_MarkerImage2->geometry ( ).contains ( e->pos ( ) ) ) {
 			int index = ui_.HorizontalSlider_MarkerImage2->value ( );
 
-			dialog2_->SetKeyFrame ( keyframes_[ index ] );
+			dialog2_->SetKeyFrame ( GetKeyFrameWithImages ( index ) );
 			dialog2_->exec ( );
 			point2_ = dialog2_->GetPoint ( );
 		}
 
 	}
 
+	KeyFrame MarkerViewerDialog::GetKeyFrameWithImages ( int index ) const {
+
+		KeyFrame keyframe = keyframes_[ index ];
+
+		if ( !keyframe.HasImages ( ) and frame_loader_ ) {
+			frame_loader_ ( keyframe );
+		}
+
+		return keyframe;
+	}
+
 	void MarkerViewerDialog::onResultButtonsClicked ( QAbstractButton * button ) {
 
 		QPushButton * _button = ( QPushButton * ) ( button );
@@ -105,6 +105,11 @@ namespace NiS {
 			auto & keyframe1 = keyframes_[ i - 1 ];
 			auto & keyframe2 = keyframes_[ i ];
 
+			if ( frame_loader_ ) {
+				if ( !keyframe1.HasImages ( ) ) frame_loader_ ( keyframe1 );
+				if ( !keyframe2.HasImages ( ) ) frame_loader_ ( keyframe2 );
+			}
+
 			Markers markers1;
 			Markers markers2;
 
@@ -121,8 +126,12 @@ namespace NiS {
 			auto matrix = ComputeTransformationMatrix ( points2 , points1 );
 
 			keyframe2.SetAnswerAlignmentMatrix ( std::move ( Convert_OpenCV_Matx44f_To_GLM_mat4 ( matrix ) ) );
+
+			if ( frame_loader_ ) keyframe1.ReleaseImages ( );
 		}
 
+		if ( frame_loader_ ) keyframes_.back ( ).ReleaseImages ( );
+
 		emit Message ( QString ( "Done generating answers of  %1 frames. (used %2)" )
 				               .arg ( keyframes_.size ( ) )
 				               .arg ( ConvertTime ( timer.elapsed ( ) ) ) );
@@ -44,11 +44,11 @@ namespace NiS {
 					const auto x2 = cvRound ( point2.x );
 					const auto y2 = cvRound ( point2.y );
 
-					const auto point3d1 = keyframe1.GetPointImage ( ).at < cv::Vec3f > ( y1 , x1 );
-					const auto point3d2 = keyframe2.GetPointImage ( ).at < cv::Vec3f > ( y2 , x2 );
+					const auto point3d1 = keyframe1.GetPoint ( y1 , x1 );
+					const auto point3d2 = keyframe2.GetPoint ( y2 , x2 );
 
-					if ( std::isfinite ( point3d1 ( 0 ) ) and std::isfinite ( point3d2 ( 0 ) ) and
-					     point3d1 != cv::Vec3f ( 0.0f , 0.0f , 0.0f ) and point3d2 != cv::Vec3f ( 0.0f , 0.0f , 0.0f ) ) {
+					if ( std::isfinite ( point3d1.x ) and std::isfinite ( point3d2.x ) and
+					     point3d1 != cv::Point3f ( 0.0f , 0.0f , 0.0f ) and point3d2 != cv::Point3f ( 0.0f , 0.0f , 0.0f ) ) {
 						points1.push_back ( point3d1 );
 						points2.push_back ( point3d2 );
 					}
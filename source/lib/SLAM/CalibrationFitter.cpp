@@ -0,0 +1,278 @@
+#include "SLAM/CalibrationFitter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <Core/Utility.h>
+
+namespace NiS {
+
+	namespace {
+
+		const int    kPlaneSampleStep      = 4;         // pixels used for the plane of a frame
+		const int    kMinPlanePoints       = 100;
+		const int    kPlaneIterations      = 5;
+		const double kMinInlierDistance    = 0.005;     // metres
+		const double kMaxDepthCorrection   = 0.1;       // samples further than 10 % from the plane are not on the target
+		const double kMillimetresPerMetre  = 1000.0;
+		const int    kMaxCoefficientCount  = 8;
+
+		// Solves a x = b (n x n, row major) by Gaussian elimination with partial pivoting, false when singular
+		bool Solve ( double * a , double * b , int n ) {
+
+			for ( auto k = 0 ; k < n ; ++k ) {
+
+				int pivot = k;
+
+				for ( auto i = k + 1 ; i < n ; ++i ) {
+					if ( std::abs ( a[ i * n + k ] ) > std::abs ( a[ pivot * n + k ] ) ) {
+						pivot = i;
+					}
+				}
+
+				if ( !( std::abs ( a[ pivot * n + k ] ) > 1e-12 * std::abs ( a[ 0 ] ) ) ) {
+					return false;
+				}
+
+				if ( pivot != k ) {
+					for ( auto j = 0 ; j < n ; ++j ) {
+						std::swap ( a[ k * n + j ] , a[ pivot * n + j ] );
+					}
+					std::swap ( b[ k ] , b[ pivot ] );
+				}
+
+				for ( auto i = k + 1 ; i < n ; ++i ) {
+
+					const double f = a[ i * n + k ] / a[ k * n + k ];
+
+					for ( auto j = k ; j < n ; ++j ) {
+						a[ i * n + j ] -= f * a[ k * n + j ];
+					}
+					b[ i ] -= f * b[ k ];
+				}
+			}
+
+			for ( auto k = n - 1 ; k >= 0 ; --k ) {
+
+				for ( auto j = k + 1 ; j < n ; ++j ) {
+					b[ k ] -= a[ k * n + j ] * b[ j ];
+				}
+				b[ k ] /= a[ k * n + k ];
+			}
+
+			return true;
+		}
+	}
+
+	CalibrationFitter::CalibrationFitter ( int rows , int cols , int degree ) :
+			rows_ ( rows ) ,
+			cols_ ( cols ) ,
+			degree_ ( LimitRange ( degree , 0 , kMaxCoefficientCount - 1 ) ) ,
+			sum_count_ ( 3 * degree_ + 3 ) ,
+			frame_count_ ( 0 ) ,
+			sums_ ( static_cast < std::size_t > ( rows ) * cols * sum_count_ , 0.0 ) {
+
+		converter_.SetFrameSize ( cv::Size ( cols , rows ) );
+
+		rays_ = converter_.ConvertDepthImage ( DepthImage ( rows , cols , static_cast < ushort > ( kMillimetresPerMetre ) ) );
+	}
+
+	bool CalibrationFitter::FitPlane ( const PointImage & points , cv::Vec4d & plane ) const {
+
+		std::vector < cv::Vec3d > samples;
+
+		for ( auto row = 0 ; row < points.rows ; row += kPlaneSampleStep ) {
+			for ( auto col = 0 ; col < points.cols ; col += kPlaneSampleStep ) {
+
+				const cv::Vec3f & p = points ( row , col );
+
+				if ( p[ 2 ] < 0 ) {
+					samples.push_back ( cv::Vec3d ( p[ 0 ] , p[ 1 ] , p[ 2 ] ) );
+				}
+			}
+		}
+
+		std::vector < char > inliers ( samples.size ( ) , 1 );
+
+		for ( auto iteration = 0 ; iteration < kPlaneIterations ; ++iteration ) {
+
+			cv::Vec3d center ( 0 , 0 , 0 );
+			int       count = 0;
+
+			for ( size_t i = 0 ; i < samples.size ( ) ; ++i ) {
+				if ( inliers[ i ] ) {
+					center += samples[ i ];
+					++count;
+				}
+			}
+
+			if ( count < kMinPlanePoints ) {
+				return false;
+			}
+
+			center *= 1.0 / count;
+
+			cv::Matx33d covariance = cv::Matx33d::zeros ( );
+
+			for ( size_t i = 0 ; i < samples.size ( ) ; ++i ) {
+				if ( inliers[ i ] ) {
+					const cv::Vec3d d = samples[ i ] - center;
+					covariance += d * d.t ( );
+				}
+			}
+
+			// Normal : eigenvector of the smallest eigenvalue (the last one)
+			cv::Mat eigen_values , eigen_vectors;
+			cv::eigen ( cv::Mat ( covariance ) , eigen_values , eigen_vectors );
+
+			const cv::Vec3d normal ( eigen_vectors.at < double > ( 2 , 0 ) ,
+			                         eigen_vectors.at < double > ( 2 , 1 ) ,
+			                         eigen_vectors.at < double > ( 2 , 2 ) );
+
+			plane = cv::Vec4d ( normal[ 0 ] , normal[ 1 ] , normal[ 2 ] , -normal.dot ( center ) );
+
+			// Points far from the plane are not on the target
+			double squared_sum = 0;
+
+			for ( size_t i = 0 ; i < samples.size ( ) ; ++i ) {
+				if ( inliers[ i ] ) {
+					const double distance = normal.dot ( samples[ i ] ) + plane[ 3 ];
+					squared_sum += distance * distance;
+				}
+			}
+
+			const double threshold = std::max ( 3 * std::sqrt ( squared_sum / count ) , kMinInlierDistance );
+
+			for ( size_t i = 0 ; i < samples.size ( ) ; ++i ) {
+				inliers[ i ] = std::abs ( normal.dot ( samples[ i ] ) + plane[ 3 ] ) < threshold;
+			}
+		}
+
+		return true;
+	}
+
+	bool CalibrationFitter::AddFrame ( const DepthImage & depth_image ) {
+
+		if ( depth_image.rows != rows_ or depth_image.cols != cols_ ) {
+			return false;
+		}
+
+		cv::Vec4d plane;
+
+		if ( !FitPlane ( converter_.ConvertDepthImage ( depth_image ) , plane ) ) {
+			return false;
+		}
+
+		const int degree    = degree_;
+		const int sum_count = sum_count_;
+
+		cv::parallel_for_ ( cv::Range ( 0 , rows_ ) , ParallelRange ( [ & ] ( const cv::Range & range ) {
+
+			for ( auto row = range.start ; row < range.end ; ++row ) {
+				for ( auto col = 0 ; col < cols_ ; ++col ) {
+
+					const ushort depth = depth_image ( row , col );
+
+					if ( depth == 0 ) {
+						continue;
+					}
+
+					// Depth of the plane along the ray of the pixel, both in metres
+					const cv::Vec3f & ray       = rays_ ( row , col );
+					const double      along     = plane[ 0 ] * ray[ 0 ] + plane[ 1 ] * ray[ 1 ] + plane[ 2 ] * ray[ 2 ];
+					const double      reference = -plane[ 3 ] / along;
+					const double      t         = depth / kMillimetresPerMetre;
+
+					if ( !( reference > 0 ) or std::abs ( reference - t ) > kMaxDepthCorrection * t ) {
+						continue;
+					}
+
+					double * sums = & sums_[ ( static_cast < std::size_t > ( row ) * cols_ + col ) * sum_count ];
+
+					double power = t * t;
+
+					for ( auto m = 0 ; m <= 2 * degree ; ++m ) {
+						sums[ m ] += power;
+						power *= t;
+					}
+
+					power = t;
+
+					for ( auto j = 0 ; j <= degree ; ++j ) {
+						sums[ 2 * degree + 1 + j ] += power * reference;
+						power *= t;
+					}
+
+					sums[ sum_count - 1 ] += 1;
+				}
+			}
+		} ) );
+
+		++frame_count_;
+
+		return true;
+	}
+
+	InternalCalibrationInfo CalibrationFitter::Fit ( int min_samples ) const {
+
+		const int         count      = degree_ + 1;
+		const std::size_t plane_size = static_cast < std::size_t > ( rows_ ) * cols_;
+
+		std::vector < float > planes ( plane_size * count , 0.0f );
+
+		const int sum_count = sum_count_;
+
+		cv::parallel_for_ ( cv::Range ( 0 , rows_ ) , ParallelRange ( [ & ] ( const cv::Range & range ) {
+
+			double a[ kMaxCoefficientCount * kMaxCoefficientCount ];
+			double b[ kMaxCoefficientCount ];
+
+			for ( auto row = range.start ; row < range.end ; ++row ) {
+				for ( auto col = 0 ; col < cols_ ; ++col ) {
+
+					const std::size_t offset = static_cast < std::size_t > ( row ) * cols_ + col;
+					const double      * sums = & sums_[ offset * sum_count ];
+
+					// Normal equations of the basis t^(k+1)
+					for ( auto j = 0 ; j < count ; ++j ) {
+						for ( auto k = 0 ; k < count ; ++k ) {
+							a[ j * count + k ] = sums[ j + k ];
+						}
+						b[ j ] = sums[ 2 * degree_ + 1 + j ];
+					}
+
+					if ( sums[ sum_count - 1 ] < std::max ( min_samples , count ) or !Solve ( a , b , count ) ) {
+
+						// Raw depth : P = 1
+						planes[ offset ] = 1.0f;
+						continue;
+					}
+
+					// P(t) with t in metres to P(depth) with the depth in millimetres
+					double scale = 1.0;
+
+					for ( auto k = 0 ; k < count ; ++k ) {
+						planes[ k * plane_size + offset ] = static_cast < float > ( b[ k ] * scale );
+						scale /= kMillimetresPerMetre;
+					}
+				}
+			}
+		} ) );
+
+		InternalCalibrationInfo info;
+
+		info.local_calibration_table = FlatCalibrationTable ( rows_ , cols_ , count ,
+		                                                      std::vector < std::uint8_t > ( plane_size , static_cast < std::uint8_t > ( count ) ) ,
+		                                                      std::move ( planes ) );
+
+		const float xz_factor = std::tan ( CoordinateConverter::XtionFrameProperty::kXtionHorizontalFOV / 2 ) * 2;
+		const float yz_factor = std::tan ( CoordinateConverter::XtionFrameProperty::kXtionVerticalFOV / 2 ) * 2;
+
+		info.global_calibration_vector = { 1.0f };
+		info.hfov_calibration_vector   = { 0.0f , xz_factor };
+		info.vfov_calibration_vector   = { 0.0f , yz_factor };
+
+		return info;
+	}
+
+}
@@ -3,13 +3,50 @@
 //
 
 #include "SLAM/Calibrator.h"
+#include <Core/FramePool.h>
 #include <Core/Serialize.h>
+#include <Core/Simd.h>
+#include <Core/Utility.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include <boost/iostreams/device/mapped_file.hpp>
 
 namespace {
 
     using namespace std;
 
     const std::string kFileHeader = "InternalCalibration";
+    const int kCalibrationFileVersion = 1;     // the version is not checked by the reader
+
+    // Alignment of the coefficient planes of .fcal files
+    const std::uint64_t kFlatCalibrationAlignment = 64;
+
+    // Rows per task of CalibrateImage
+    const int kTileRows = 16;
+
+#if defined(__SSE2__)
+
+    // EvaluatePolynomial for 4 values, the same operations so that every column gets the same result
+    inline __m128 Polynomial4(const std::vector<float> &coef, __m128 x) {
+
+        if (coef.empty()) {
+            return _mm_setzero_ps();
+        }
+
+        __m128 y = _mm_set1_ps(coef.back());
+
+        for (auto k = static_cast<int>(coef.size()) - 2; k >= 0; --k) {
+            y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(coef[k]));
+        }
+
+        return y;
+    }
+
+#endif
 
 }
 
@@ -18,6 +55,7 @@ namespace NiS {
     Calibrator::Calibrator(const std::string &path) {
 
         internal_calibration_data_ = ReadHelper(path);
+        local_calibration_table_ = internal_calibration_data_.local_calibration_table;
     }
 
     Calibrator::Calibrator() {
@@ -28,64 +66,321 @@ namespace NiS {
 
     }
 
-    PointImage Calibrator::CalibrateImage(const cv::Mat &depth_image) {
+    PointImage Calibrator::CalibrateImage(const cv::Mat &depth_image) const {
 
         const int rows = depth_image.rows;
         const int cols = depth_image.cols;
 
-        PointImage point_image(rows, cols);
+        PointImage point_image = CreatePooledImage<cv::Vec3f>(rows, cols);
 
-        for (int row = 0; row < rows; ++row) {
-            for (int col = 0; col < cols; ++col) {
+        std::vector<float> col_factors(static_cast<std::size_t>(cols));
 
-                point_image(row, col) = ScreenToWorld(row, col, depth_image.at<ushort>(row, col),
-                                                      depth_image.rows,
-                                                      depth_image.cols);
-            }
+        for (int col = 0; col < cols; ++col) {
+            col_factors[col] = static_cast< float >( col ) / cols - 0.5f;
         }
 
+        const int tiles = (rows + kTileRows - 1) / kTileRows;
+
+        cv::parallel_for_(cv::Range(0, tiles), ParallelRange([&](const cv::Range &range) {
+
+            std::vector<float> buffer(static_cast<std::size_t>(cols) * 2);
+
+            for (int tile = range.start; tile < range.end; ++tile) {
+                for (int row = tile * kTileRows; row < std::min(rows, (tile + 1) * kTileRows); ++row) {
+                    CalibrateRow(row, depth_image.ptr<ushort>(row), rows, cols, col_factors.data(), buffer.data(),
+                                 point_image[row]);
+                }
+            }
+        }));
+
         return point_image;
 
     }
 
-    Calibrator::InternalCalibrationData Calibrator::ReadHelper(const std::string &path) {
+    void Calibrator::CalibrateRow(int row, const ushort *depth, int rows, int cols, const float *col_factors,
+                                  float *buffer, cv::Vec3f *points) const {
+
+        float *depth_values = buffer;
+        float *corrected = buffer + cols;
+
+        for (int col = 0; col < cols; ++col) {
+            depth_values[col] = depth[col];
+        }
+
+        local_calibration_table_.CorrectDistortionRow(row, 0, cols, depth_values, corrected);
+
+        const CoefficientsVector &global = internal_calibration_data_.global_calibration_vector;
+        const CoefficientsVector &hfov = internal_calibration_data_.hfov_calibration_vector;
+        const CoefficientsVector &vfov = internal_calibration_data_.vfov_calibration_vector;
+
+        const float row_factor = static_cast< float >( row ) / rows - 0.5f;
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+
+        float *values = reinterpret_cast<float *>(points);
+        int col = 0;
 
-        using namespace std;
+#if defined(__SSE2__)
+        const __m128 scale = _mm_set1_ps(0.001f);
+        const __m128 row_factor4 = _mm_set1_ps(row_factor);
+        const __m128 nan4 = _mm_set1_ps(nan);
 
-        std::ifstream in(path, std::ios::binary);
+        for (; col + 4 <= cols; col += 4) {
+
+            __m128 gz = _mm_loadu_ps(corrected + col);
+
+            if (!global.empty()) {
+                gz = _mm_mul_ps(gz, Polynomial4(global, gz));
+            }
+
+            gz = _mm_mul_ps(gz, scale);
+
+            const __m128 gx = _mm_mul_ps(Polynomial4(hfov, gz), _mm_loadu_ps(col_factors + col));
+            const __m128 gy = _mm_mul_ps(Polynomial4(vfov, gz), row_factor4);
+
+            // NaN without depth
+            const __m128 valid = _mm_cmpgt_ps(_mm_loadu_ps(depth_values + col), _mm_setzero_ps());
+            const __m128 invalid = _mm_andnot_ps(valid, nan4);
+
+            StorePoints4(values + col * 3,
+                         _mm_or_ps(_mm_and_ps(valid, gx), invalid),
+                         _mm_or_ps(_mm_and_ps(valid, Negate4(gy)), invalid),
+                         _mm_or_ps(_mm_and_ps(valid, Negate4(gz)), invalid));
+        }
+#endif
+
+        for (; col < cols; ++col) {
+
+            if (depth[col] == 0) {
+                points[col] = cv::Vec3f(nan, nan, nan);
+                continue;
+            }
+
+            const float gz = CorrectDepth(corrected[col]) * 0.001f;
+            const float gx = EvaluatePolynomial(hfov, gz) * col_factors[col];
+            const float gy = EvaluatePolynomial(vfov, gz) * row_factor;
+
+            points[col] = cv::Vec3f(gx, -gy, -gz);
+        }
+    }
+
+    Calibrator::InternalCalibrationData Calibrator::ReadHelper(const std::string &path) {
+
+        const InternalCalibrationInfo info = InternalCalibrationReader::Read(path);
 
         InternalCalibrationData data;
 
+        data.local_calibration_table = info.local_calibration_table;
+        data.global_calibration_vector = info.global_calibration_vector;
+        data.hfov_calibration_vector = info.hfov_calibration_vector;
+        data.vfov_calibration_vector = info.vfov_calibration_vector;
+
+        return data;
+    }
+
+    InternalCalibrationInfo InternalCalibrationReader::Read(const std::string &file_name) {
+
+        std::ifstream in(file_name, std::ios::binary);
+
+        char magic[sizeof(kFlatCalibrationMagic)] = {};
+        in.read(magic, sizeof(magic));
+
+        if (in and std::memcmp(magic, kFlatCalibrationMagic, sizeof(magic)) == 0) {
+            return ReadFlat(file_name);
+        }
+
+        return ReadCal(file_name);
+    }
+
+    InternalCalibrationInfo InternalCalibrationReader::ReadCal(const std::string &file_name) {
+
+        using CoefficientsVector = InternalCalibrationInfo::CoefficientsVector;
+
+        std::ifstream in(file_name, std::ios::binary);
+
+        InternalCalibrationInfo info;
+
         if (in) {
 
             const std::string head = NiS::ReadString(in, static_cast < unsigned int >( kFileHeader.size()));
             const int version = NiS::Read<int>(in);
 
-            LocalCalibrationTable table(static_cast<unsigned long>(NiS::Read<int>(in)));
+            InternalCalibrationInfo::LocalCalibrationTable table(static_cast<unsigned long>(NiS::Read<int>(in)));
 
             for (auto &coef_line : table) {
                 coef_line.resize(static_cast<unsigned long>(NiS::Read<int>(in)));
                 for (auto &coef : coef_line) {
                     coef = NiS::ReadVector<CoefficientsVector::value_type>(in);
                 }
+            }
+
+            info.local_calibration_table = FlatCalibrationTable(table);
+            info.global_calibration_vector = NiS::ReadVector<CoefficientsVector::value_type>(in);
+            info.hfov_calibration_vector = NiS::ReadVector<CoefficientsVector::value_type>(in);
+            info.vfov_calibration_vector = NiS::ReadVector<CoefficientsVector::value_type>(in);
+        }
+
+        return info;
+    }
+
+    InternalCalibrationInfo InternalCalibrationReader::ReadFlat(const std::string &file_name) {
+
+        namespace bio = boost::iostreams;
+
+        InternalCalibrationInfo info;
+
+        std::shared_ptr<bio::mapped_file_source> file;
+
+        try {
+            file = std::make_shared<bio::mapped_file_source>(file_name);
+        }
+        catch (const std::exception &e) {
+            std::cout << "File mapping failed : " << file_name << " (" << e.what() << ")" << std::endl;
+            return info;
+        }
+
+        const char *data = file->data();
+        const std::size_t size = file->size();
+
+        FlatCalibrationHeader header;
+
+        if (size < sizeof(header)) {
+            std::cout << "Broken calibration file : " << file_name << std::endl;
+            return info;
+        }
+
+        std::memcpy(&header, data, sizeof(header));
+
+        const std::uint64_t plane_size = static_cast<std::uint64_t>(std::max(header.rows, 0)) * std::max(header.cols, 0);
+        const std::uint64_t vectors_size =
+                (static_cast<std::uint64_t>(std::max(header.global_count, 0)) + std::max(header.hfov_count, 0) +
+                 std::max(header.vfov_count, 0)) * sizeof(float);
+
+        if (std::memcmp(header.magic, kFlatCalibrationMagic, sizeof(header.magic)) != 0 or
+            header.version != kFlatCalibrationVersion or
+            header.rows < 0 or header.cols < 0 or header.coefficient_count < 0 or header.coefficient_count > 255 or
+            header.global_count < 0 or header.hfov_count < 0 or header.vfov_count < 0 or
+            sizeof(header) + vectors_size > size or
+            header.counts_offset > size or plane_size > size - header.counts_offset or
+            header.planes_offset % sizeof(float) != 0 or header.planes_offset > size or
+            plane_size * header.coefficient_count * sizeof(float) > size - header.planes_offset) {
+
+            std::cout << "Broken calibration file : " << file_name << std::endl;
+            return info;
+        }
+
+        const float *vectors = reinterpret_cast<const float *>(data + sizeof(header));
+
+        info.global_calibration_vector.assign(vectors, vectors + header.global_count);
+        vectors += header.global_count;
+        info.hfov_calibration_vector.assign(vectors, vectors + header.hfov_count);
+        vectors += header.hfov_count;
+        info.vfov_calibration_vector.assign(vectors, vectors + header.vfov_count);
+
+        info.local_calibration_table = FlatCalibrationTable(header.rows, header.cols, header.coefficient_count,
+                                                            reinterpret_cast<const std::uint8_t *>(data + header.counts_offset),
+                                                            reinterpret_cast<const float *>(data + header.planes_offset),
+                                                            file);
+
+        return info;
+    }
+
+    bool InternalCalibrationReader::WriteCal(const std::string &file_name, const InternalCalibrationInfo &info) {
+
+        std::ofstream out(file_name, std::ios::binary);
+
+        if (!out) {
+            return false;
+        }
+
+        const FlatCalibrationTable &table = info.local_calibration_table;
+        const std::size_t plane_size = static_cast<std::size_t>(table.GetRows()) * table.GetCols();
+
+        out.write(kFileHeader.data(), kFileHeader.size());
+        NiS::Write<int>(out, kCalibrationFileVersion);
+        NiS::Write<int>(out, table.GetRows());
+
+        std::vector<float> coef;
+
+        for (int row = 0; row < table.GetRows(); ++row) {
+
+            NiS::Write<int>(out, table.GetCols());
+
+            for (int col = 0; col < table.GetCols(); ++col) {
+
+                const std::size_t offset = static_cast<std::size_t>(row) * table.GetCols() + col;
+
+                coef.resize(table.GetCounts()[offset]);
+
+                for (std::size_t k = 0; k < coef.size(); ++k) {
+                    coef[k] = table.GetPlanes()[k * plane_size + offset];
+                }
 
+                NiS::WriteVector(out, coef);
             }
+        }
+
+        NiS::WriteVector(out, info.global_calibration_vector);
+        NiS::WriteVector(out, info.hfov_calibration_vector);
+        NiS::WriteVector(out, info.vfov_calibration_vector);
 
-            data.local_calibration_table = table;
+        return static_cast<bool>(out);
+    }
 
-            //
-            data.global_calibration_vector = NiS::ReadVector<CoefficientsVector::value_type>(in);
+    bool InternalCalibrationReader::WriteFlat(const std::string &file_name, const InternalCalibrationInfo &info) {
 
-            //
-            data.hfov_calibration_vector = NiS::ReadVector<CoefficientsVector::value_type>(in);
-            data.vfov_calibration_vector = NiS::ReadVector<CoefficientsVector::value_type>(in);
+        std::ofstream out(file_name, std::ios::binary);
 
+        if (!out) {
+            return false;
         }
 
-        return data;
+        const FlatCalibrationTable &table = info.local_calibration_table;
+        const std::uint64_t plane_size = static_cast<std::uint64_t>(table.GetRows()) * table.GetCols();
+
+        FlatCalibrationHeader header = {};
+
+        std::memcpy(header.magic, kFlatCalibrationMagic, sizeof(header.magic));
+        header.version = kFlatCalibrationVersion;
+        header.rows = table.GetRows();
+        header.cols = table.GetCols();
+        header.coefficient_count = table.GetCoefficientCount();
+        header.global_count = static_cast<std::int32_t>(info.global_calibration_vector.size());
+        header.hfov_count = static_cast<std::int32_t>(info.hfov_calibration_vector.size());
+        header.vfov_count = static_cast<std::int32_t>(info.vfov_calibration_vector.size());
+        header.counts_offset = sizeof(header) +
+                               (info.global_calibration_vector.size() + info.hfov_calibration_vector.size() +
+                                info.vfov_calibration_vector.size()) * sizeof(float);
+        header.planes_offset = (header.counts_offset + plane_size + kFlatCalibrationAlignment - 1) /
+                               kFlatCalibrationAlignment * kFlatCalibrationAlignment;
+
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        for (const auto *vector : {&info.global_calibration_vector, &info.hfov_calibration_vector,
+                                   &info.vfov_calibration_vector}) {
+            out.write(reinterpret_cast<const char *>(vector->data()), vector->size() * sizeof(float));
+        }
+
+        if (plane_size > 0) {
+            out.write(reinterpret_cast<const char *>(table.GetCounts()), plane_size);
+        }
+
+        const std::vector<char> padding(header.planes_offset - header.counts_offset - plane_size, 0);
+        out.write(padding.data(), padding.size());
+
+        if (plane_size * table.GetCoefficientCount() > 0) {
+            out.write(reinterpret_cast<const char *>(table.GetPlanes()),
+                      plane_size * table.GetCoefficientCount() * sizeof(float));
+        }
+
+        return static_cast<bool>(out);
+    }
+
+    void Calibrator::SetFrameSize(const cv::Size &size) {
+
+        local_calibration_table_ = internal_calibration_data_.local_calibration_table.Resample(size.height, size.width);
     }
 
-    cv::Point3f Calibrator::ScreenToWorld(int row, int col, float depth, int rows, int cols) {
+    cv::Point3f Calibrator::ScreenToWorld(int row, int col, float depth, int rows, int cols) const {
 
         cv::Point3f pt(std::numeric_limits<float>::quiet_NaN(),
                        std::numeric_limits<float>::quiet_NaN(),
@@ -94,8 +389,8 @@ namespace NiS {
         if (depth > 0) {
 
             const float gz = CorrectDepth(CorrectDistortion(row, col, depth)) * 0.001f;
-            const float xz_factor = NthDegreeEquation(internal_calibration_data_.hfov_calibration_vector, gz);
-            const float yz_factor = NthDegreeEquation(internal_calibration_data_.vfov_calibration_vector, gz);
+            const float xz_factor = EvaluatePolynomial(internal_calibration_data_.hfov_calibration_vector, gz);
+            const float yz_factor = EvaluatePolynomial(internal_calibration_data_.vfov_calibration_vector, gz);
             const float gx = xz_factor * (static_cast< float >( col ) / cols - 0.5f);
             const float gy = yz_factor * (static_cast< float >( row ) / rows - 0.5f);
 
@@ -107,10 +402,10 @@ namespace NiS {
         return pt;
     }
 
-    cv::Point2f Calibrator::WorldToScreen(cv::Point3f const &point, int rows, int cols) {
+    cv::Point2f Calibrator::WorldToScreen(cv::Point3f const &point, int rows, int cols) const {
 
-        const float xz_factor = NthDegreeEquation(internal_calibration_data_.hfov_calibration_vector, point.z);
-        const float yz_factor = NthDegreeEquation(internal_calibration_data_.vfov_calibration_vector, point.z);
+        const float xz_factor = EvaluatePolynomial(internal_calibration_data_.hfov_calibration_vector, point.z);
+        const float yz_factor = EvaluatePolynomial(internal_calibration_data_.vfov_calibration_vector, point.z);
         const float x = (point.x / xz_factor + 0.5f) * cols;
         const float y = (point.y / yz_factor + 0.5f) * rows;
         return cv::Point2f(x, y);
@@ -0,0 +1,139 @@
+#include "SLAM/CompactPointImage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <Core/FramePool.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace NiS {
+
+	namespace {
+
+		const float kMillimetre = 0.001f;
+
+		inline bool Quantize ( float value , std::int16_t & quantized ) {
+
+			const float millimetres = std::round ( value / kMillimetre );
+
+			if ( !( std::abs ( millimetres ) <= std::numeric_limits < std::int16_t >::max ( ) ) ) {
+				return false;
+			}
+
+			quantized = static_cast < std::int16_t > ( millimetres );
+			return true;
+		}
+	}
+
+	CompactPointImage::CompactPointImage ( ) :
+			rows_ ( 0 ) ,
+			cols_ ( 0 ) ,
+			words_per_row_ ( 0 ) { }
+
+	CompactPointImage::CompactPointImage ( const PointImage & point_image ) :
+			rows_ ( point_image.rows ) ,
+			cols_ ( point_image.cols ) ,
+			words_per_row_ ( ( point_image.cols + 63 ) / 64 ) ,
+			xyz_ ( static_cast < std::size_t > ( point_image.rows ) * point_image.cols * 3 , 0 ) ,
+			valid_ ( static_cast < std::size_t > ( point_image.rows ) * ( ( point_image.cols + 63 ) / 64 ) , 0 ) {
+
+		for ( auto row = 0 ; row < rows_ ; ++row ) {
+
+			const cv::Vec3f * points = point_image[ row ];
+			std::int16_t    * xyz    = & xyz_[ static_cast < std::size_t > ( row ) * cols_ * 3 ];
+			std::uint64_t   * valid  = & valid_[ static_cast < std::size_t > ( row ) * words_per_row_ ];
+
+			for ( auto col = 0 ; col < cols_ ; ++col ) {
+
+				std::int16_t x , y , z;
+
+				if ( Quantize ( points[ col ][ 0 ] , x ) and Quantize ( points[ col ][ 1 ] , y ) and Quantize ( points[ col ][ 2 ] , z ) ) {
+
+					xyz[ col * 3 + 0 ] = x;
+					xyz[ col * 3 + 1 ] = y;
+					xyz[ col * 3 + 2 ] = z;
+
+					valid[ col / 64 ] |= std::uint64_t ( 1 ) << ( col % 64 );
+				}
+			}
+		}
+	}
+
+	WorldPoint CompactPointImage::At ( int row , int col ) const {
+
+		if ( !IsValid ( row , col ) ) {
+			const float nan = std::numeric_limits < float >::quiet_NaN ( );
+			return WorldPoint ( nan , nan , nan );
+		}
+
+		const std::int16_t * xyz = & xyz_[ ( static_cast < std::size_t > ( row ) * cols_ + col ) * 3 ];
+
+		return WorldPoint ( xyz[ 0 ] * kMillimetre , xyz[ 1 ] * kMillimetre , xyz[ 2 ] * kMillimetre );
+	}
+
+	void CompactPointImage::DecodeRow ( int row , cv::Vec3f * points ) const {
+
+		const std::int16_t * xyz    = & xyz_[ static_cast < std::size_t > ( row ) * cols_ * 3 ];
+		float              * values = reinterpret_cast < float * > ( points );
+
+		const int count = cols_ * 3;
+		int       i     = 0;
+
+#if defined(__SSE2__)
+		const __m128 scale = _mm_set1_ps ( kMillimetre );
+
+		for ( ; i + 8 <= count ; i += 8 ) {
+
+			const __m128i v = _mm_loadu_si128 ( reinterpret_cast < const __m128i * > ( xyz + i ) );
+
+			// Sign extension of the 16 bit values
+			const __m128i low  = _mm_srai_epi32 ( _mm_unpacklo_epi16 ( v , v ) , 16 );
+			const __m128i high = _mm_srai_epi32 ( _mm_unpackhi_epi16 ( v , v ) , 16 );
+
+			_mm_storeu_ps ( values + i , _mm_mul_ps ( _mm_cvtepi32_ps ( low ) , scale ) );
+			_mm_storeu_ps ( values + i + 4 , _mm_mul_ps ( _mm_cvtepi32_ps ( high ) , scale ) );
+		}
+#endif
+
+		for ( ; i < count ; ++i ) {
+			values[ i ] = xyz[ i ] * kMillimetre;
+		}
+
+		// Invalid points, whole valid words are skipped
+		const std::uint64_t * valid = & valid_[ static_cast < std::size_t > ( row ) * words_per_row_ ];
+		const float         nan     = std::numeric_limits < float >::quiet_NaN ( );
+
+		for ( auto word = 0 ; word < words_per_row_ ; ++word ) {
+
+			const int           begin = word * 64;
+			const int           end   = std::min ( begin + 64 , cols_ );
+			const std::uint64_t full  = end - begin == 64 ? ~std::uint64_t ( 0 ) : ( std::uint64_t ( 1 ) << ( end - begin ) ) - 1;
+
+			if ( valid[ word ] == full ) {
+				continue;
+			}
+
+			for ( auto col = begin ; col < end ; ++col ) {
+				if ( !( ( valid[ word ] >> ( col - begin ) ) & 1 ) ) {
+					points[ col ] = cv::Vec3f ( nan , nan , nan );
+				}
+			}
+		}
+	}
+
+	PointImage CompactPointImage::Decode ( ) const {
+
+		PointImage point_image = CreatePooledImage < cv::Vec3f > ( rows_ , cols_ );
+
+		for ( auto row = 0 ; row < rows_ ; ++row ) {
+			DecodeRow ( row , point_image[ row ] );
+		}
+
+		return point_image;
+	}
+
+}
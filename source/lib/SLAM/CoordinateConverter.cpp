@@ -4,6 +4,16 @@
 
 #include "SLAM/CoordinateConverter.h"
 
+#include <algorithm>
+
+#include <Core/FramePool.h>
+#include <Core/Simd.h>
+
+// The AVX2 kernel is built whatever the build targets, the CPU decides at run time whether it is used
+#if ( defined(__x86_64__) or defined(__i386__) ) and defined(__GNUC__)
+#include <immintrin.h>
+#define NIS_CONVERSION_DISPATCH 1
+#endif
 
 namespace NiS {
 
@@ -12,14 +22,164 @@ namespace NiS {
 	const float CoordinateConverter::XtionFrameProperty::kXtionWidth         = 640;
 	const float CoordinateConverter::XtionFrameProperty::kXtionHeight        = 480;
 
+	namespace {
+
+		const float kDepthScale = 0.001f;
+
+		// Points of the depth values of a row, x_rays by column and the y ray of the row
+		using RowConversion = void ( * ) ( const ushort * depth , const float * x_rays , float y_ray , int cols , float * values );
+
+		// Columns [col, cols) of a row
+		inline void ConvertRowFrom ( int col , const ushort * depth , const float * x_rays , float y_ray , int cols , float * values ) {
+
+#if defined(__SSE2__)
+			const __m128 scale4 = _mm_set1_ps ( kDepthScale );
+			const __m128 y_ray4 = _mm_set1_ps ( y_ray );
+
+			for ( ; col + 4 <= cols ; col += 4 ) {
+
+				const __m128 millimetres = LoadDepth4 ( depth + col );
+
+				StorePoints4 ( values + col * 3 , _mm_mul_ps ( millimetres , _mm_loadu_ps ( x_rays + col ) ) , _mm_mul_ps ( millimetres , y_ray4 ) ,
+				               Negate4 ( _mm_mul_ps ( millimetres , scale4 ) ) );
+			}
+#endif
+
+			for ( ; col < cols ; ++col ) {
+
+				const float millimetres = static_cast < float > ( depth[ col ] );
+
+				values[ col * 3 + 0 ] = millimetres * x_rays[ col ];
+				values[ col * 3 + 1 ] = millimetres * y_ray;
+				values[ col * 3 + 2 ] = -( millimetres * kDepthScale );
+			}
+		}
+
+		void ConvertRowGeneric ( const ushort * depth , const float * x_rays , float y_ray , int cols , float * values ) {
+
+			ConvertRowFrom ( 0 , depth , x_rays , y_ray , cols , values );
+		}
+
+#if defined(NIS_CONVERSION_DISPATCH)
+
+		// 8 pixels at a time, the rest as ConvertRowGeneric
+		__attribute__ ( ( target ( "avx2" ) ) )
+		void ConvertRowAvx2 ( const ushort * depth , const float * x_rays , float y_ray , int cols , float * values ) {
+
+			const __m256 scale8 = _mm256_set1_ps ( kDepthScale );
+			const __m256 y_ray8 = _mm256_set1_ps ( y_ray );
+
+			int col = 0;
+
+			for ( ; col + 8 <= cols ; col += 8 ) {
+
+				const __m128i d = _mm_loadu_si128 ( reinterpret_cast < const __m128i * > ( depth + col ) );
+				const __m256  millimetres = _mm256_cvtepi32_ps ( _mm256_cvtepu16_epi32 ( d ) );
+				const __m256  x = _mm256_mul_ps ( millimetres , _mm256_loadu_ps ( x_rays + col ) );
+				const __m256  y = _mm256_mul_ps ( millimetres , y_ray8 );
+				const __m256  gz = _mm256_mul_ps ( millimetres , scale8 );
+
+				StorePoints4 ( values + col * 3 , _mm256_castps256_ps128 ( x ) , _mm256_castps256_ps128 ( y ) ,
+				               Negate4 ( _mm256_castps256_ps128 ( gz ) ) );
+				StorePoints4 ( values + col * 3 + 12 , _mm256_extractf128_ps ( x , 1 ) , _mm256_extractf128_ps ( y , 1 ) ,
+				               Negate4 ( _mm256_extractf128_ps ( gz , 1 ) ) );
+			}
+
+			ConvertRowFrom ( col , depth , x_rays , y_ray , cols , values );
+		}
+
+#endif
+
+		RowConversion SelectRowConversion ( ) {
+
+#if defined(NIS_CONVERSION_DISPATCH)
+			__builtin_cpu_init ( );
+
+			if ( __builtin_cpu_supports ( "avx2" ) ) {
+				return ConvertRowAvx2;
+			}
+#endif
+
+			return ConvertRowGeneric;
+		}
+	}
+
+	PointImage CoordinateConverter::ConvertDepthImage ( const DepthImage & depth_image ) const {
+
+		PointImage point_image = CreatePooledImage < cv::Vec3f > ( depth_image.rows , depth_image.cols );
+
+		for ( auto row = 0 ; row < depth_image.rows ; ++row ) {
+
+			const ushort * depth  = depth_image[ row ];
+			cv::Vec3f    * points = point_image[ row ];
+
+			for ( auto col = 0 ; col < depth_image.cols ; ++col ) {
+				const WorldPoint p = ScreenToWorld ( ScreenPoint ( col , row ) , depth[ col ] );
+				points[ col ] = cv::Vec3f ( p.x , p.y , p.z );
+			}
+		}
+
+		return point_image;
+	}
+
+	std::vector < float > XtionCoordinateConverter::MakeRays ( float factor , float size , int count ) {
+
+		std::vector < float > rays ( static_cast < std::size_t > ( std::max ( count , 0 ) ) );
+
+		for ( auto i = 0 ; i < count ; ++i ) {
+			rays[ i ] = kDepthScale * factor * ( static_cast < float > ( i ) / size - 0.5f );
+		}
+
+		return rays;
+	}
+
+	void XtionCoordinateConverter::SetFrameSize ( const cv::Size & size ) {
+
+		CoordinateConverter::SetFrameSize ( size );
+
+		x_rays_ = MakeRays ( universal_xz_factor_ , frame_width_ , size.width );
+		y_rays_ = MakeRays ( -universal_yz_factor_ , frame_height_ , size.height );
+	}
+
+	PointImage XtionCoordinateConverter::ConvertDepthImage ( const DepthImage & depth_image ) const {
+
+		const int rows = depth_image.rows;
+		const int cols = depth_image.cols;
+
+		// The tables cover the frame, larger images get their own
+		std::vector < float > local_x_rays , local_y_rays;
+		const float * x_rays = x_rays_.data ( );
+		const float * y_rays = y_rays_.data ( );
+
+		if ( cols > static_cast < int > ( x_rays_.size ( ) ) ) {
+			local_x_rays = MakeRays ( universal_xz_factor_ , frame_width_ , cols );
+			x_rays       = local_x_rays.data ( );
+		}
+
+		if ( rows > static_cast < int > ( y_rays_.size ( ) ) ) {
+			local_y_rays = MakeRays ( -universal_yz_factor_ , frame_height_ , rows );
+			y_rays       = local_y_rays.data ( );
+		}
+
+		static const RowConversion convert_row = SelectRowConversion ( );
+
+		PointImage point_image = CreatePooledImage < cv::Vec3f > ( rows , cols );
+
+		for ( auto row = 0 ; row < rows ; ++row ) {
+			convert_row ( depth_image[ row ] , x_rays , y_rays[ row ] , cols , reinterpret_cast < float * > ( point_image[ row ] ) );
+		}
+
+		return point_image;
+	}
+
 	WorldPoint XtionCoordinateConverter::ScreenToWorld ( ScreenPoint const & screen_point , ushort const depth ) const {
 
-		const auto gz = 0.001f * static_cast<float>(depth);
+		const auto gz = kDepthScale * static_cast<float>(depth);
 
 		WorldPoint p;
 
-		p.x = gz * universal_xz_factor_ * ( screen_point.x / XtionFrameProperty::kXtionWidth - 0.5f );
-		p.y = -gz * universal_yz_factor_ * ( screen_point.y / XtionFrameProperty::kXtionHeight - 0.5f );
+		p.x = gz * universal_xz_factor_ * ( screen_point.x / frame_width_ - 0.5f );
+		p.y = -gz * universal_yz_factor_ * ( screen_point.y / frame_height_ - 0.5f );
 		p.z = -gz;
 
 		return p;
@@ -27,8 +187,8 @@ namespace NiS {
 
 	ScreenPoint XtionCoordinateConverter::WorldToScreen ( WorldPoint const & world_point ) const {
 
-		const auto x = ( world_point.x / ( world_point.z * universal_xz_factor_ ) + 0.5f ) * XtionFrameProperty::kXtionWidth;
-		const auto y = ( world_point.y / ( world_point.z * universal_yz_factor_ ) + 0.5f ) * XtionFrameProperty::kXtionHeight;
+		const auto x = ( world_point.x / ( world_point.z * universal_xz_factor_ ) + 0.5f ) * frame_width_;
+		const auto y = ( world_point.y / ( world_point.z * universal_yz_factor_ ) + 0.5f ) * frame_height_;
 
 		return ScreenPoint ( x , y );
 	}
@@ -43,10 +203,10 @@ namespace NiS {
 					CorrectDistortion ( static_cast<int>(screen_point.y) , static_cast<int>(screen_point.x) , depth ) ) *
 			                 0.001f;
 
-			const float xz_factor = NthDegreeEquation ( internal_calibration_info_.hfov_calibration_vector , gz );
-			const float yz_factor = NthDegreeEquation ( internal_calibration_info_.vfov_calibration_vector , gz );
-			const float gx        = xz_factor * ( static_cast< float >( screen_point.x ) / XtionFrameProperty::kXtionWidth - 0.5f );
-			const float gy        = yz_factor * ( static_cast< float >( screen_point.y ) / XtionFrameProperty::kXtionHeight - 0.5f );
+			const float xz_factor = EvaluatePolynomial ( internal_calibration_info_.hfov_calibration_vector , gz );
+			const float yz_factor = EvaluatePolynomial ( internal_calibration_info_.vfov_calibration_vector , gz );
+			const float gx        = xz_factor * ( static_cast< float >( screen_point.x ) / frame_width_ - 0.5f );
+			const float gy        = yz_factor * ( static_cast< float >( screen_point.y ) / frame_height_ - 0.5f );
 
 			pt.x = gx;
 			pt.y = -gy;
@@ -56,12 +216,19 @@ namespace NiS {
 		return pt;
 	}
 
+	void AistCoordinateConverter::SetFrameSize ( const cv::Size & size ) {
+
+		CoordinateConverter::SetFrameSize ( size );
+
+		local_calibration_table_ = internal_calibration_info_.local_calibration_table.Resample ( size.height , size.width );
+	}
+
 	ScreenPoint AistCoordinateConverter::WorldToScreen ( WorldPoint const & world_point ) const {
 
-		const float xz_factor = NthDegreeEquation ( internal_calibration_info_.hfov_calibration_vector , world_point.z );
-		const float yz_factor = NthDegreeEquation ( internal_calibration_info_.vfov_calibration_vector , world_point.z );
-		const float x         = ( world_point.x / xz_factor + 0.5f ) * XtionFrameProperty::kXtionWidth;
-		const float y         = ( world_point.y / yz_factor + 0.5f ) * XtionFrameProperty::kXtionHeight;
+		const float xz_factor = EvaluatePolynomial ( internal_calibration_info_.hfov_calibration_vector , world_point.z );
+		const float yz_factor = EvaluatePolynomial ( internal_calibration_info_.vfov_calibration_vector , world_point.z );
+		const float x         = ( world_point.x / xz_factor + 0.5f ) * frame_width_;
+		const float y         = ( world_point.y / yz_factor + 0.5f ) * frame_height_;
 		return ScreenPoint ( x , y );
 	}
 
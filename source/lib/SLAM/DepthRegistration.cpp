@@ -0,0 +1,284 @@
+#include "SLAM/DepthRegistration.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+#include <Core/FramePool.h>
+#include <Core/Simd.h>
+
+namespace NiS {
+
+	namespace {
+
+		const float  kDepthScale  = 0.001f;
+		const float  kMaxDepth    = 65534.0f;
+		const ushort kEmptyDepth  = std::numeric_limits < ushort >::max ( );     // z-buffer value of unreached pixels
+	}
+
+	const std::string DepthRegistration::kFileExtension = ".reg";
+
+	DepthRegistration::DepthRegistration ( ) :
+			identity_ ( true ) ,
+			depth_to_color_ ( 1.0f ) ,
+			color_hfov_ ( CoordinateConverter::XtionFrameProperty::kXtionHorizontalFOV ) ,
+			color_vfov_ ( CoordinateConverter::XtionFrameProperty::kXtionVerticalFOV ) ,
+			color_xz_factor_ ( 0 ) ,
+			color_yz_factor_ ( 0 ) { }
+
+	DepthRegistration::DepthRegistration ( const glm::mat4 & depth_to_color , float color_hfov , float color_vfov ) :
+			identity_ ( depth_to_color == glm::mat4 ( 1.0f ) and
+			            color_hfov == CoordinateConverter::XtionFrameProperty::kXtionHorizontalFOV and
+			            color_vfov == CoordinateConverter::XtionFrameProperty::kXtionVerticalFOV ) ,
+			depth_to_color_ ( depth_to_color ) ,
+			color_hfov_ ( color_hfov ) ,
+			color_vfov_ ( color_vfov ) ,
+			color_xz_factor_ ( std::tan ( color_hfov / 2 ) * 2 ) ,
+			color_yz_factor_ ( std::tan ( color_vfov / 2 ) * 2 ) {
+
+		if ( !identity_ ) {
+			rays_ = MakeRayTables ( static_cast < int > ( CoordinateConverter::XtionFrameProperty::kXtionHeight ) ,
+			                        static_cast < int > ( CoordinateConverter::XtionFrameProperty::kXtionWidth ) );
+		}
+	}
+
+	DepthRegistration DepthRegistration::Read ( const std::string & file_name ) {
+
+		std::ifstream in ( file_name );
+
+		glm::mat4 depth_to_color;
+
+		// glm is column major
+		for ( auto row = 0 ; row < 4 ; ++row ) {
+			for ( auto col = 0 ; col < 4 ; ++col ) {
+				in >> depth_to_color[ col ][ row ];
+			}
+		}
+
+		if ( !in ) {
+			std::cout << "Could not read depth registration : " << file_name << std::endl;
+			return DepthRegistration ( );
+		}
+
+		float hfov = CoordinateConverter::XtionFrameProperty::kXtionHorizontalFOV;
+		float vfov = CoordinateConverter::XtionFrameProperty::kXtionVerticalFOV;
+
+		float fov[ 2 ];
+
+		if ( in >> fov[ 0 ] >> fov[ 1 ] ) {
+			hfov = fov[ 0 ];
+			vfov = fov[ 1 ];
+		}
+
+		return DepthRegistration ( depth_to_color , hfov , vfov );
+	}
+
+	std::uint64_t DepthRegistration::Hash ( ) const {
+
+		if ( identity_ ) {
+			return 0;
+		}
+
+		float values[ 18 ];
+
+		for ( auto col = 0 ; col < 4 ; ++col ) {
+			for ( auto row = 0 ; row < 4 ; ++row ) {
+				values[ col * 4 + row ] = depth_to_color_[ col ][ row ];
+			}
+		}
+
+		values[ 16 ] = color_hfov_;
+		values[ 17 ] = color_vfov_;
+
+		unsigned char bytes[ sizeof ( values ) ];
+		std::memcpy ( bytes , values , sizeof ( values ) );
+
+		// FNV-1a
+		std::uint64_t hash = 14695981039346656037ull;
+
+		for ( auto byte : bytes ) {
+			hash ^= byte;
+			hash *= 1099511628211ull;
+		}
+
+		return hash == 0 ? 1 : hash;
+	}
+
+	DepthRegistration::RayTables DepthRegistration::MakeRayTables ( int rows , int cols ) const {
+
+		const float width     = static_cast < float > ( cols );
+		const float height    = static_cast < float > ( rows );
+		const float xz_factor = std::tan ( CoordinateConverter::XtionFrameProperty::kXtionHorizontalFOV / 2 ) * 2;
+		const float yz_factor = std::tan ( CoordinateConverter::XtionFrameProperty::kXtionVerticalFOV / 2 ) * 2;
+
+		RayTables tables;
+		tables.rows = rows;
+		tables.cols = cols;
+		tables.x.resize ( static_cast < std::size_t > ( rows ) * cols );
+		tables.y.resize ( tables.x.size ( ) );
+		tables.z.resize ( tables.x.size ( ) );
+
+		for ( auto row = 0 ; row < rows ; ++row ) {
+			for ( auto col = 0 ; col < cols ; ++col ) {
+
+				// Ray of XtionCoordinateConverter::ScreenToWorld for frames of rows x cols, rotated to the color frame
+				const glm::vec4 ray ( kDepthScale * xz_factor * ( static_cast < float > ( col ) / width - 0.5f ) ,
+				                      -kDepthScale * yz_factor * ( static_cast < float > ( row ) / height - 0.5f ) ,
+				                      -kDepthScale , 0.0f );
+				const glm::vec4 rotated = depth_to_color_ * ray;
+
+				const std::size_t i = static_cast < std::size_t > ( row ) * cols + col;
+				tables.x[ i ] = rotated.x;
+				tables.y[ i ] = rotated.y;
+				tables.z[ i ] = rotated.z;
+			}
+		}
+
+		return tables;
+	}
+
+	DepthImage DepthRegistration::Register ( const DepthImage & depth_image ) const {
+
+		if ( identity_ or depth_image.empty ( ) ) {
+			return depth_image;
+		}
+
+		const int rows = depth_image.rows;
+		const int cols = depth_image.cols;
+
+		RayTables       local_rays;
+		const RayTables * rays = & rays_;
+
+		if ( rows != rays_.rows or cols != rays_.cols ) {
+			local_rays = MakeRayTables ( rows , cols );
+			rays       = & local_rays;
+		}
+
+		const float tx = depth_to_color_[ 3 ][ 0 ];
+		const float ty = depth_to_color_[ 3 ][ 1 ];
+		const float tz = depth_to_color_[ 3 ][ 2 ];
+
+		// Xtion projection of the color camera : col = (x / -z / xz + 0.5) width, row = (-y / -z / yz + 0.5) height
+		const float fu = cols / color_xz_factor_;
+		const float fv = rows / color_yz_factor_;
+		const float cu = cols * 0.5f;
+		const float cv = rows * 0.5f;
+
+		DepthImage registered = CreatePooledImage < ushort > ( rows , cols );
+		registered.setTo ( kEmptyDepth );
+
+		// Projection of a row : color pixel and depth in millimetres, 0 when there is nothing to splat
+		std::vector < float > us ( static_cast < std::size_t > ( cols ) );
+		std::vector < float > vs ( us.size ( ) );
+		std::vector < float > zs ( us.size ( ) );
+
+		for ( auto row = 0 ; row < rows ; ++row ) {
+
+			const ushort      * depth  = depth_image[ row ];
+			const std::size_t offset = static_cast < std::size_t > ( row ) * cols;
+			const float       * ray_x  = rays->x.data ( ) + offset;
+			const float       * ray_y  = rays->y.data ( ) + offset;
+			const float       * ray_z  = rays->z.data ( ) + offset;
+
+			int col = 0;
+
+#if defined(__SSE2__)
+			const __m128 tx4   = _mm_set1_ps ( tx );
+			const __m128 ty4   = _mm_set1_ps ( ty );
+			const __m128 tz4   = _mm_set1_ps ( tz );
+			const __m128 fu4   = _mm_set1_ps ( fu );
+			const __m128 fv4   = _mm_set1_ps ( fv );
+			const __m128 cu4   = _mm_set1_ps ( cu );
+			const __m128 cv4   = _mm_set1_ps ( cv );
+			const __m128 one   = _mm_set1_ps ( 1.0f );
+			const __m128 zero  = _mm_setzero_ps ( );
+			const __m128 scale = _mm_set1_ps ( 1.0f / kDepthScale );
+
+			for ( ; col + 4 <= cols ; col += 4 ) {
+
+				const __m128 d = LoadDepth4 ( depth + col );
+				const __m128 x = _mm_add_ps ( _mm_mul_ps ( d , _mm_loadu_ps ( ray_x + col ) ) , tx4 );
+				const __m128 y = _mm_add_ps ( _mm_mul_ps ( d , _mm_loadu_ps ( ray_y + col ) ) , ty4 );
+				const __m128 z = Negate4 ( _mm_add_ps ( _mm_mul_ps ( d , _mm_loadu_ps ( ray_z + col ) ) , tz4 ) );     // in front : > 0
+
+				const __m128 inverse = _mm_div_ps ( one , z );
+				const __m128 u       = _mm_add_ps ( _mm_mul_ps ( _mm_mul_ps ( fu4 , x ) , inverse ) , cu4 );
+				const __m128 v       = _mm_sub_ps ( cv4 , _mm_mul_ps ( _mm_mul_ps ( fv4 , y ) , inverse ) );
+
+				// Without depth or behind the color camera
+				const __m128 valid = _mm_and_ps ( _mm_cmpgt_ps ( d , zero ) , _mm_cmpgt_ps ( z , zero ) );
+
+				_mm_storeu_ps ( & us[ col ] , u );
+				_mm_storeu_ps ( & vs[ col ] , v );
+				_mm_storeu_ps ( & zs[ col ] , _mm_and_ps ( valid , _mm_mul_ps ( z , scale ) ) );
+			}
+#endif
+
+			for ( ; col < cols ; ++col ) {
+
+				const float d = depth[ col ];
+				const float x = d * ray_x[ col ] + tx;
+				const float y = d * ray_y[ col ] + ty;
+				const float z = -( d * ray_z[ col ] + tz );
+
+				us[ col ] = fu * x / z + cu;
+				vs[ col ] = cv - fv * y / z;
+				zs[ col ] = d > 0 and z > 0 ? z / kDepthScale : 0.0f;
+			}
+
+			// Splat with the z-buffer, the scattered writes stay scalar
+			for ( col = 0 ; col < cols ; ++col ) {
+
+				const float u = us[ col ];
+				const float v = vs[ col ];
+
+				if ( !( zs[ col ] > 0 ) or !( u > -1 and u < cols and v > -1 and v < rows ) ) {
+					continue;
+				}
+
+				const ushort value = static_cast < ushort > ( std::min ( zs[ col ] + 0.5f , kMaxDepth ) );
+				const int    u0    = static_cast < int > ( std::floor ( u ) );
+				const int    v0    = static_cast < int > ( std::floor ( v ) );
+
+				for ( auto r = std::max ( v0 , 0 ) ; r <= std::min ( v0 + 1 , rows - 1 ) ; ++r ) {
+
+					ushort * target = registered[ r ];
+
+					for ( auto c = std::max ( u0 , 0 ) ; c <= std::min ( u0 + 1 , cols - 1 ) ; ++c ) {
+						target[ c ] = std::min ( target[ c ] , value );
+					}
+				}
+			}
+		}
+
+		// Unreached pixels have no depth
+		for ( auto row = 0 ; row < rows ; ++row ) {
+
+			ushort * depth = registered[ row ];
+
+			int col = 0;
+
+#if defined(__SSE2__)
+			const __m128i empty = _mm_set1_epi16 ( static_cast < short > ( kEmptyDepth ) );
+
+			for ( ; col + 8 <= cols ; col += 8 ) {
+
+				const __m128i d = _mm_loadu_si128 ( reinterpret_cast < const __m128i * > ( depth + col ) );
+				_mm_storeu_si128 ( reinterpret_cast < __m128i * > ( depth + col ) , _mm_andnot_si128 ( _mm_cmpeq_epi16 ( d , empty ) , d ) );
+			}
+#endif
+
+			for ( ; col < cols ; ++col ) {
+				if ( depth[ col ] == kEmptyDepth ) {
+					depth[ col ] = 0;
+				}
+			}
+		}
+
+		return registered;
+	}
+
+}
@@ -0,0 +1,184 @@
+#include "SLAM/FlatCalibrationTable.h"
+
+#include <algorithm>
+
+#include <Core/Simd.h>
+
+namespace NiS {
+
+	namespace {
+
+		struct OwnedPlanes
+		{
+			std::vector < std::uint8_t > counts;
+			std::vector < float >        planes;
+		};
+	}
+
+	FlatCalibrationTable::FlatCalibrationTable ( ) :
+			rows_ ( 0 ) ,
+			cols_ ( 0 ) ,
+			coefficient_count_ ( 0 ) ,
+			counts_ ( nullptr ) ,
+			planes_ ( nullptr ) { }
+
+	FlatCalibrationTable::FlatCalibrationTable ( int rows , int cols , int coefficient_count , const std::uint8_t * counts ,
+	                                             const float * planes , std::shared_ptr < const void > storage ) :
+			rows_ ( rows ) ,
+			cols_ ( cols ) ,
+			coefficient_count_ ( coefficient_count ) ,
+			counts_ ( counts ) ,
+			planes_ ( planes ) ,
+			storage_ ( std::move ( storage ) ) { }
+
+	FlatCalibrationTable::FlatCalibrationTable ( int rows , int cols , int coefficient_count ,
+	                                             std::vector < std::uint8_t > counts , std::vector < float > planes ) :
+			rows_ ( rows ) ,
+			cols_ ( cols ) ,
+			coefficient_count_ ( coefficient_count ) {
+
+		auto owned = std::make_shared < OwnedPlanes > ( );
+		owned->counts = std::move ( counts );
+		owned->planes = std::move ( planes );
+
+		counts_  = owned->counts.data ( );
+		planes_  = owned->planes.data ( );
+		storage_ = owned;
+	}
+
+	FlatCalibrationTable::FlatCalibrationTable ( const LocalCalibrationTable & table ) :
+			rows_ ( static_cast < int > ( table.size ( ) ) ) ,
+			cols_ ( 0 ) ,
+			coefficient_count_ ( 0 ) ,
+			counts_ ( nullptr ) ,
+			planes_ ( nullptr ) {
+
+		for ( const auto & line : table ) {
+
+			cols_ = std::max ( cols_ , static_cast < int > ( line.size ( ) ) );
+
+			for ( const auto & coef : line ) {
+				coefficient_count_ = std::max ( coefficient_count_ , static_cast < int > ( coef.size ( ) ) );
+			}
+		}
+
+		// The counts are bytes
+		coefficient_count_ = std::min ( coefficient_count_ , 255 );
+
+		const std::size_t plane_size = static_cast < std::size_t > ( rows_ ) * cols_;
+
+		std::vector < std::uint8_t > counts ( plane_size , 0 );
+		std::vector < float >        planes ( plane_size * coefficient_count_ , 0.0f );
+
+		for ( auto row = 0 ; row < rows_ ; ++row ) {
+			for ( auto col = 0 ; col < static_cast < int > ( table[ row ].size ( ) ) ; ++col ) {
+
+				const auto & coef  = table[ row ][ col ];
+				const int    count = std::min ( static_cast < int > ( coef.size ( ) ) , coefficient_count_ );
+
+				counts[ row * cols_ + col ] = static_cast < std::uint8_t > ( count );
+
+				for ( auto k = 0 ; k < count ; ++k ) {
+					planes[ k * plane_size + row * cols_ + col ] = coef[ k ];
+				}
+			}
+		}
+
+		* this = FlatCalibrationTable ( rows_ , cols_ , coefficient_count_ , std::move ( counts ) , std::move ( planes ) );
+	}
+
+	FlatCalibrationTable FlatCalibrationTable::Resample ( int rows , int cols ) const {
+
+		if ( ( rows == rows_ and cols == cols_ ) or IsEmpty ( ) or rows <= 0 or cols <= 0 ) {
+			return * this;
+		}
+
+		const std::size_t plane_size         = static_cast < std::size_t > ( rows_ ) * cols_;
+		const std::size_t sampled_plane_size = static_cast < std::size_t > ( rows ) * cols;
+
+		std::vector < std::uint8_t > counts ( sampled_plane_size );
+		std::vector < float >        planes ( sampled_plane_size * coefficient_count_ );
+
+		for ( auto row = 0 ; row < rows ; ++row ) {
+
+			const std::size_t source_row = static_cast < std::size_t > ( row ) * rows_ / rows;
+
+			for ( auto col = 0 ; col < cols ; ++col ) {
+
+				const std::size_t source = source_row * cols_ + static_cast < std::size_t > ( col ) * cols_ / cols;
+				const std::size_t target = static_cast < std::size_t > ( row ) * cols + col;
+
+				counts[ target ] = counts_[ source ];
+
+				for ( auto k = 0 ; k < coefficient_count_ ; ++k ) {
+					planes[ k * sampled_plane_size + target ] = planes_[ k * plane_size + source ];
+				}
+			}
+		}
+
+		return FlatCalibrationTable ( rows , cols , coefficient_count_ , std::move ( counts ) , std::move ( planes ) );
+	}
+
+	float FlatCalibrationTable::CorrectDistortion ( int row , int col , float depth ) const {
+
+		if ( row < 0 or row >= rows_ or col < 0 or col >= cols_ or coefficient_count_ == 0 ) {
+			return 0.0f;
+		}
+
+		const std::size_t plane_size = static_cast < std::size_t > ( rows_ ) * cols_;
+		const std::size_t offset     = static_cast < std::size_t > ( row ) * cols_ + col;
+
+		// Horner
+		float y = planes_[ ( coefficient_count_ - 1 ) * plane_size + offset ];
+
+		for ( auto k = coefficient_count_ - 2 ; k >= 0 ; --k ) {
+			y = y * depth + planes_[ k * plane_size + offset ];
+		}
+
+		return depth * y;
+	}
+
+	void FlatCalibrationTable::CorrectDistortionRow ( int row , int col , int count , const float * depth , float * corrected ) const {
+
+		if ( row < 0 or row >= rows_ or col < 0 or col + count > cols_ or coefficient_count_ == 0 ) {
+
+			for ( auto i = 0 ; i < count ; ++i ) {
+				corrected[ i ] = CorrectDistortion ( row , col + i , depth[ i ] );
+			}
+
+			return;
+		}
+
+		const std::size_t plane_size = static_cast < std::size_t > ( rows_ ) * cols_;
+		const float       * first    = planes_ + static_cast < std::size_t > ( row ) * cols_ + col;
+		const int         last       = coefficient_count_ - 1;
+
+		int i = 0;
+
+#if defined(__SSE2__)
+		for ( ; i + 4 <= count ; i += 4 ) {
+
+			const __m128 d = _mm_loadu_ps ( depth + i );
+			__m128       y = _mm_loadu_ps ( first + last * plane_size + i );
+
+			for ( auto k = last - 1 ; k >= 0 ; --k ) {
+				y = _mm_add_ps ( _mm_mul_ps ( y , d ) , _mm_loadu_ps ( first + k * plane_size + i ) );
+			}
+
+			_mm_storeu_ps ( corrected + i , _mm_mul_ps ( d , y ) );
+		}
+#endif
+
+		for ( ; i < count ; ++i ) {
+
+			float y = first[ last * plane_size + i ];
+
+			for ( auto k = last - 1 ; k >= 0 ; --k ) {
+				y = y * depth[ i ] + first[ k * plane_size + i ];
+			}
+
+			corrected[ i ] = depth[ i ] * y;
+		}
+	}
+
+}
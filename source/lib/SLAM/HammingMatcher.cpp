@@ -0,0 +1,265 @@
+#include "SLAM/DescriptorMatcher.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+// The SIMD kernels are built for their instruction sets whatever the build targets, the CPU picks one at run time
+#if ( defined(__x86_64__) or defined(__i386__) ) and defined(__GNUC__)
+#include <immintrin.h>
+#define NIS_HAMMING_DISPATCH 1
+#if ( defined(__clang__) and __clang_major__ >= 7 ) or ( !defined(__clang__) and __GNUC__ >= 8 )
+#define NIS_HAMMING_AVX512 1
+#endif
+#endif
+
+namespace NiS {
+
+	namespace {
+
+		// Rows of the 1st set per block, and of the 2nd set (256 ORB rows are 8 KB)
+		const int kBlockRows1 = 64;
+		const int kBlockRows2 = 256;
+
+		// Distances of row to the count consecutive rows from rows
+		using RowDistances = void ( * ) ( const std::uint64_t * row , const std::uint64_t * rows , int count , int words ,
+		                                  int * distances );
+
+		inline int Distance ( const std::uint64_t * a , const std::uint64_t * b , int words ) {
+
+			int distance = 0;
+
+			for ( auto w = 0 ; w < words ; ++w ) {
+				distance += __builtin_popcountll ( a[ w ] ^ b[ w ] );
+			}
+
+			return distance;
+		}
+
+		void RowDistancesGeneric ( const std::uint64_t * row , const std::uint64_t * rows , int count , int words , int * distances ) {
+
+			for ( auto j = 0 ; j < count ; ++j ) {
+				distances[ j ] = Distance ( row , rows + static_cast < std::size_t > ( j ) * words , words );
+			}
+		}
+
+#if defined(NIS_HAMMING_DISPATCH)
+
+		// The same with the popcnt instruction instead of the software popcount
+		__attribute__ ( ( target ( "popcnt" ) ) )
+		void RowDistancesPopcnt ( const std::uint64_t * row , const std::uint64_t * rows , int count , int words , int * distances ) {
+
+			for ( auto j = 0 ; j < count ; ++j ) {
+				distances[ j ] = Distance ( row , rows + static_cast < std::size_t > ( j ) * words , words );
+			}
+		}
+
+		// Bit counts of the 4 words of v : nibble lookup, the byte counts are summed by word with sad
+		__attribute__ ( ( target ( "avx2" ) ) )
+		inline __m256i Popcount4 ( __m256i v ) {
+
+			const __m256i lookup   = _mm256_setr_epi8 ( 0 , 1 , 1 , 2 , 1 , 2 , 2 , 3 , 1 , 2 , 2 , 3 , 2 , 3 , 3 , 4 ,
+			                                            0 , 1 , 1 , 2 , 1 , 2 , 2 , 3 , 1 , 2 , 2 , 3 , 2 , 3 , 3 , 4 );
+			const __m256i low_mask = _mm256_set1_epi8 ( 0x0F );
+
+			const __m256i low    = _mm256_and_si256 ( v , low_mask );
+			const __m256i high   = _mm256_and_si256 ( _mm256_srli_epi16 ( v , 4 ) , low_mask );
+			const __m256i counts = _mm256_add_epi8 ( _mm256_shuffle_epi8 ( lookup , low ) , _mm256_shuffle_epi8 ( lookup , high ) );
+
+			return _mm256_sad_epu8 ( counts , _mm256_setzero_si256 ( ) );
+		}
+
+		// Stores the sums of the 4 lanes of s0 .. s3 to distances
+		__attribute__ ( ( target ( "avx2" ) ) )
+		inline void StoreSums4 ( __m256i s0 , __m256i s1 , __m256i s2 , __m256i s3 , int * distances ) {
+
+			const __m256i t01 = _mm256_add_epi64 ( _mm256_unpacklo_epi64 ( s0 , s1 ) , _mm256_unpackhi_epi64 ( s0 , s1 ) );   // s0 s1 s0 s1
+			const __m256i t23 = _mm256_add_epi64 ( _mm256_unpacklo_epi64 ( s2 , s3 ) , _mm256_unpackhi_epi64 ( s2 , s3 ) );   // s2 s3 s2 s3
+			const __m256i sum = _mm256_add_epi64 ( _mm256_permute2x128_si256 ( t01 , t23 , 0x20 ) ,
+			                                       _mm256_permute2x128_si256 ( t01 , t23 , 0x31 ) );                         // s0 s1 s2 s3
+
+			const __m256i low = _mm256_permutevar8x32_epi32 ( sum , _mm256_setr_epi32 ( 0 , 2 , 4 , 6 , 0 , 2 , 4 , 6 ) );
+			_mm_storeu_si128 ( reinterpret_cast < __m128i * > ( distances ) , _mm256_castsi256_si128 ( low ) );
+		}
+
+		// 4 rows at a time, the rows are 32 bytes aligned (BinaryDescriptors)
+		__attribute__ ( ( target ( "avx2,popcnt" ) ) )
+		void RowDistancesAvx2 ( const std::uint64_t * row , const std::uint64_t * rows , int count , int words , int * distances ) {
+
+			int j = 0;
+
+			for ( ; j + 4 <= count ; j += 4 ) {
+
+				const std::uint64_t * b = rows + static_cast < std::size_t > ( j ) * words;
+
+				__m256i s0 = _mm256_setzero_si256 ( );
+				__m256i s1 = _mm256_setzero_si256 ( );
+				__m256i s2 = _mm256_setzero_si256 ( );
+				__m256i s3 = _mm256_setzero_si256 ( );
+
+				for ( auto w = 0 ; w < words ; w += 4 ) {
+
+					const __m256i q = _mm256_load_si256 ( reinterpret_cast < const __m256i * > ( row + w ) );
+
+					s0 = _mm256_add_epi64 ( s0 , Popcount4 ( _mm256_xor_si256 ( q , _mm256_load_si256 ( reinterpret_cast < const __m256i * > ( b + w ) ) ) ) );
+					s1 = _mm256_add_epi64 ( s1 , Popcount4 ( _mm256_xor_si256 ( q , _mm256_load_si256 ( reinterpret_cast < const __m256i * > ( b + words + w ) ) ) ) );
+					s2 = _mm256_add_epi64 ( s2 , Popcount4 ( _mm256_xor_si256 ( q , _mm256_load_si256 ( reinterpret_cast < const __m256i * > ( b + 2 * words + w ) ) ) ) );
+					s3 = _mm256_add_epi64 ( s3 , Popcount4 ( _mm256_xor_si256 ( q , _mm256_load_si256 ( reinterpret_cast < const __m256i * > ( b + 3 * words + w ) ) ) ) );
+				}
+
+				StoreSums4 ( s0 , s1 , s2 , s3 , distances + j );
+			}
+
+			for ( ; j < count ; ++j ) {
+				distances[ j ] = Distance ( row , rows + static_cast < std::size_t > ( j ) * words , words );
+			}
+		}
+
+#if defined(NIS_HAMMING_AVX512)
+
+		// The same with the popcount of AVX-512 VPOPCNTDQ
+		__attribute__ ( ( target ( "avx512f,avx512vl,avx512vpopcntdq,avx2,popcnt" ) ) )
+		void RowDistancesAvx512 ( const std::uint64_t * row , const std::uint64_t * rows , int count , int words , int * distances ) {
+
+			int j = 0;
+
+			for ( ; j + 4 <= count ; j += 4 ) {
+
+				const std::uint64_t * b = rows + static_cast < std::size_t > ( j ) * words;
+
+				__m256i s0 = _mm256_setzero_si256 ( );
+				__m256i s1 = _mm256_setzero_si256 ( );
+				__m256i s2 = _mm256_setzero_si256 ( );
+				__m256i s3 = _mm256_setzero_si256 ( );
+
+				for ( auto w = 0 ; w < words ; w += 4 ) {
+
+					const __m256i q = _mm256_load_si256 ( reinterpret_cast < const __m256i * > ( row + w ) );
+
+					s0 = _mm256_add_epi64 ( s0 , _mm256_popcnt_epi64 ( _mm256_xor_si256 ( q , _mm256_load_si256 ( reinterpret_cast < const __m256i * > ( b + w ) ) ) ) );
+					s1 = _mm256_add_epi64 ( s1 , _mm256_popcnt_epi64 ( _mm256_xor_si256 ( q , _mm256_load_si256 ( reinterpret_cast < const __m256i * > ( b + words + w ) ) ) ) );
+					s2 = _mm256_add_epi64 ( s2 , _mm256_popcnt_epi64 ( _mm256_xor_si256 ( q , _mm256_load_si256 ( reinterpret_cast < const __m256i * > ( b + 2 * words + w ) ) ) ) );
+					s3 = _mm256_add_epi64 ( s3 , _mm256_popcnt_epi64 ( _mm256_xor_si256 ( q , _mm256_load_si256 ( reinterpret_cast < const __m256i * > ( b + 3 * words + w ) ) ) ) );
+				}
+
+				StoreSums4 ( s0 , s1 , s2 , s3 , distances + j );
+			}
+
+			for ( ; j < count ; ++j ) {
+				distances[ j ] = Distance ( row , rows + static_cast < std::size_t > ( j ) * words , words );
+			}
+		}
+
+#endif
+#endif
+
+		// Best kernel of the CPU, chosen once
+		RowDistances SelectRowDistances ( ) {
+
+#if defined(NIS_HAMMING_DISPATCH)
+			__builtin_cpu_init ( );
+
+#if defined(NIS_HAMMING_AVX512)
+			if ( __builtin_cpu_supports ( "avx512vpopcntdq" ) and __builtin_cpu_supports ( "avx512vl" ) ) {
+				return RowDistancesAvx512;
+			}
+#endif
+
+			if ( __builtin_cpu_supports ( "avx2" ) and __builtin_cpu_supports ( "popcnt" ) ) {
+				return RowDistancesAvx2;
+			}
+
+			if ( __builtin_cpu_supports ( "popcnt" ) ) {
+				return RowDistancesPopcnt;
+			}
+#endif
+
+			return RowDistancesGeneric;
+		}
+	}
+
+	const int BinaryDescriptors::kRowAlignment;
+
+	BinaryDescriptors::BinaryDescriptors ( const cv::Mat & descriptors ) :
+			count_ ( descriptors.rows ) ,
+			words_ ( 0 ) ,
+			data_ ( nullptr ) {
+
+		const int bytes = descriptors.cols * static_cast < int > ( descriptors.elemSize ( ) );
+		const int words = kRowAlignment / static_cast < int > ( sizeof ( std::uint64_t ) );
+
+		words_ = ( bytes + kRowAlignment - 1 ) / kRowAlignment * words;
+
+		// Room to align the first row
+		buffer_.assign ( static_cast < std::size_t > ( count_ ) * words_ + words , 0 );
+
+		const std::uintptr_t address = reinterpret_cast < std::uintptr_t > ( buffer_.data ( ) );
+		data_ = reinterpret_cast < std::uint64_t * > ( ( address + kRowAlignment - 1 ) / kRowAlignment * kRowAlignment );
+
+		for ( auto i = 0 ; i < count_ ; ++i ) {
+			std::memcpy ( data_ + static_cast < std::size_t > ( i ) * words_ , descriptors.ptr ( i ) , static_cast < std::size_t > ( bytes ) );
+		}
+	}
+
+	NearestNeighbours < int > MatchHamming ( const BinaryDescriptors & descriptors1 , const BinaryDescriptors & descriptors2 ) {
+
+		const int count1 = descriptors1.GetCount ( );
+		const int count2 = descriptors2.GetCount ( );
+		const int words  = descriptors1.GetWords ( );
+
+		NearestNeighbours < int > neighbours;
+		neighbours.index1.assign ( static_cast < std::size_t > ( count1 ) , -1 );
+		neighbours.distance1.assign ( static_cast < std::size_t > ( count1 ) , std::numeric_limits < int >::max ( ) );
+		neighbours.index2.assign ( static_cast < std::size_t > ( count2 ) , -1 );
+		neighbours.distance2.assign ( static_cast < std::size_t > ( count2 ) , std::numeric_limits < int >::max ( ) );
+
+		// Descriptors of different kinds
+		if ( words != descriptors2.GetWords ( ) ) {
+			return neighbours;
+		}
+
+		static const RowDistances row_distances = SelectRowDistances ( );
+
+		int distances[ kBlockRows2 ];
+
+		// Rows and columns are visited in increasing order : the strict minima keep the lowest indices
+		for ( auto begin1 = 0 ; begin1 < count1 ; begin1 += kBlockRows1 ) {
+
+			const int end1 = std::min ( begin1 + kBlockRows1 , count1 );
+
+			for ( auto begin2 = 0 ; begin2 < count2 ; begin2 += kBlockRows2 ) {
+
+				const int end2 = std::min ( begin2 + kBlockRows2 , count2 );
+
+				for ( auto i = begin1 ; i < end1 ; ++i ) {
+
+					row_distances ( descriptors1.GetRow ( i ) , descriptors2.GetRow ( begin2 ) , end2 - begin2 , words , distances );
+
+					int best_distance = neighbours.distance1[ i ];
+					int best_index    = neighbours.index1[ i ];
+
+					for ( auto j = begin2 ; j < end2 ; ++j ) {
+
+						const int distance = distances[ j - begin2 ];
+
+						if ( distance < best_distance ) {
+							best_distance = distance;
+							best_index    = j;
+						}
+
+						if ( distance < neighbours.distance2[ j ] ) {
+							neighbours.distance2[ j ] = distance;
+							neighbours.index2[ j ]    = i;
+						}
+					}
+
+					neighbours.distance1[ i ] = best_distance;
+					neighbours.index1[ i ]    = best_index;
+				}
+			}
+		}
+
+		return neighbours;
+	}
+
+}
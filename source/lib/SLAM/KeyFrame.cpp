@@ -3,3 +3,91 @@
 //
 
 #include "SLAM/KeyFrame.h"
+
+#include <Core/FramePool.h>
+
+namespace NiS {
+
+	void KeyFrame::CreateFeature ( ) {
+
+		if ( !LoadStoredFeature ( ) ) {
+			ExtractFeature ( GetGrayImage ( ) );
+		}
+
+		ComputeKeyPointPoints ( );
+	}
+
+	void KeyFrame::ComputeKeyPointPoints ( ) {
+
+		const auto & key_points = feature_.GetKeyPoints ( );
+
+		key_point_points_.clear ( );
+		key_point_points_.reserve ( key_points.size ( ) );
+
+		// Only the key point pixels are converted
+		for ( const auto & key_point : key_points ) {
+			key_point_points_.push_back ( GetPoint ( cvRound ( key_point.pt.y ) , cvRound ( key_point.pt.x ) ) );
+		}
+	}
+
+	std::shared_ptr < FeatureStore > KeyFrame::OpenFeatureStore ( FeatureKey & key , QString & legacy_file_name ) const {
+
+		QFileInfo info ( QString::fromStdString ( name_ ) );
+
+		auto path = info.absolutePath ( );
+		auto name = info.completeBaseName ( );
+
+		key = FeatureKey { name.toStdString ( ) , type_ , feature_parameters_ };
+
+		// Features/<name>.feature files of former versions (a single feature type per frame)
+		legacy_file_name = path + "/Features/" + name + ".feature";
+
+		// One store per dataset directory
+		return FeatureStore::Open ( path.toStdString ( ) );
+	}
+
+	bool KeyFrame::LoadStoredFeature ( ) {
+
+		FeatureKey key;
+		QString    legacy_file_name;
+		auto       store = OpenFeatureStore ( key , legacy_file_name );
+
+		if ( store->Load ( key , feature_ ) ) {
+			return true;
+		}
+
+		// The former files only have features of the recorded images
+		if ( key.parameters == kDefaultFeatureParameters and QFileInfo ( legacy_file_name ).exists ( ) and
+		     LoadFeature ( legacy_file_name.toStdString ( ) , feature_ ) and feature_.GetType ( ) == type_ ) {
+			store->Store ( key , feature_ );
+			return true;
+		}
+
+		return false;
+	}
+
+	cv::Mat_ < uchar > KeyFrame::GetGrayImage ( ) const {
+
+		assert( !color_image_.empty ( ) );
+		cv::Mat_ < uchar > cvt_color_image = PooledImage < uchar > ( );
+		cv::cvtColor ( color_image_ , cvt_color_image , cv::COLOR_RGB2GRAY );
+
+		return cvt_color_image;
+	}
+
+	void KeyFrame::ExtractFeature ( const cv::Mat_ < uchar > & gray_image ) {
+
+		SetExtractedFeature ( FeatureExtractor ( type_ , detection_parameters_ ).Extract ( gray_image , depth_image_ ) );
+	}
+
+	void KeyFrame::SetExtractedFeature ( const Feature & feature ) {
+
+		FeatureKey key;
+		QString    legacy_file_name;
+		auto       store = OpenFeatureStore ( key , legacy_file_name );
+
+		feature_ = feature;
+		store->Store ( key , feature_ );
+	}
+
+}
@@ -0,0 +1,112 @@
+#include "SLAM/DescriptorMatcher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace NiS {
+
+	namespace {
+
+		// Rows of the 1st set per block, and of the 2nd set (the 128 x 512 products are 256 KB)
+		const int kBlockRows1 = 128;
+		const int kBlockRows2 = 512;
+
+		std::vector < float > SquaredNorms ( const cv::Mat & descriptors ) {
+
+			std::vector < float > norms ( static_cast < std::size_t > ( descriptors.rows ) );
+
+			for ( auto i = 0 ; i < descriptors.rows ; ++i ) {
+
+				const float * row = descriptors.ptr < float > ( i );
+
+				float norm = 0.0f;
+
+				for ( auto k = 0 ; k < descriptors.cols ; ++k ) {
+					norm += row[ k ] * row[ k ];
+				}
+
+				norms[ i ] = norm;
+			}
+
+			return norms;
+		}
+	}
+
+	NearestNeighbours < float > MatchL2 ( const cv::Mat & descriptors1 , const cv::Mat & descriptors2 ) {
+
+		const int count1 = descriptors1.rows;
+		const int count2 = descriptors2.rows;
+
+		NearestNeighbours < float > neighbours;
+		neighbours.index1.assign ( static_cast < std::size_t > ( count1 ) , -1 );
+		neighbours.distance1.assign ( static_cast < std::size_t > ( count1 ) , std::numeric_limits < float >::max ( ) );
+		neighbours.index2.assign ( static_cast < std::size_t > ( count2 ) , -1 );
+		neighbours.distance2.assign ( static_cast < std::size_t > ( count2 ) , std::numeric_limits < float >::max ( ) );
+
+		// Descriptors of different kinds
+		if ( descriptors1.type ( ) != CV_32FC1 or descriptors2.type ( ) != CV_32FC1 or descriptors1.cols != descriptors2.cols ) {
+			return neighbours;
+		}
+
+		const std::vector < float > norms1 = SquaredNorms ( descriptors1 );
+		const std::vector < float > norms2 = SquaredNorms ( descriptors2 );
+
+		cv::Mat products;
+
+		// Squared distances until the end, rows and columns are visited in increasing order : the strict minima keep
+		// the lowest indices
+		for ( auto begin1 = 0 ; begin1 < count1 ; begin1 += kBlockRows1 ) {
+
+			const int end1 = std::min ( begin1 + kBlockRows1 , count1 );
+
+			for ( auto begin2 = 0 ; begin2 < count2 ; begin2 += kBlockRows2 ) {
+
+				const int end2 = std::min ( begin2 + kBlockRows2 , count2 );
+
+				// -2ab of the blocks, the buffer is reused while the blocks keep their size
+				cv::gemm ( descriptors1.rowRange ( begin1 , end1 ) , descriptors2.rowRange ( begin2 , end2 ) , -2.0 ,
+				           cv::noArray ( ) , 0.0 , products , cv::GEMM_2_T );
+
+				for ( auto i = begin1 ; i < end1 ; ++i ) {
+
+					const float * row = products.ptr < float > ( i - begin1 );
+
+					float best_distance = neighbours.distance1[ i ];
+					int   best_index    = neighbours.index1[ i ];
+
+					for ( auto j = begin2 ; j < end2 ; ++j ) {
+
+						// Rounding can make the distance of close descriptors negative
+						const float distance = std::max ( norms1[ i ] + norms2[ j ] + row[ j - begin2 ] , 0.0f );
+
+						if ( distance < best_distance ) {
+							best_distance = distance;
+							best_index    = j;
+						}
+
+						if ( distance < neighbours.distance2[ j ] ) {
+							neighbours.distance2[ j ] = distance;
+							neighbours.index2[ j ]    = i;
+						}
+					}
+
+					neighbours.distance1[ i ] = best_distance;
+					neighbours.index1[ i ]    = best_index;
+				}
+			}
+		}
+
+		// Euclidean distances, as cv::DMatch
+		for ( auto & distance : neighbours.distance1 ) {
+			distance = std::sqrt ( distance );
+		}
+
+		for ( auto & distance : neighbours.distance2 ) {
+			distance = std::sqrt ( distance );
+		}
+
+		return neighbours;
+	}
+
+}
@@ -3,6 +3,7 @@
 //
 
 #include "SLAM/Matcher.h"
+#include "SLAM/DescriptorMatcher.h"
 #include <opencv2/legacy/legacy.hpp>
 
 namespace {
@@ -59,21 +60,61 @@ namespace {
 		return matches;
 	}
 
+	// Same selection as CreateMatches from the nearest neighbours of both directions
+	template < class Distance >
+	Matches CreateMatches ( const NiS::NearestNeighbours < Distance > & neighbours , bool cross_check ) {
+
+		Matches matches;
+
+		const int count = static_cast < int > ( neighbours.index1.size ( ) );
+
+		if ( cross_check ) {
+
+			for ( auto i = 0 ; i < count ; ++i ) {
+				if ( neighbours.IsMutual ( i ) ) {
+					matches.push_back ( Match ( i , neighbours.index1[ i ] ) );
+				}
+			}
+		}
+		else {
+
+			float sum = 0.0f;
+			int   n   = 0;
+
+			for ( auto i = 0 ; i < count ; ++i ) {
+				if ( neighbours.index1[ i ] >= 0 ) {
+					sum += neighbours.distance1[ i ];
+					++n;
+				}
+			}
+
+			const float threshold = n > 0 ? sum / n : 0.0f;
+
+			for ( auto i = 0 ; i < count ; ++i ) {
+				if ( neighbours.index1[ i ] >= 0 and neighbours.distance1[ i ] <= threshold ) {
+					matches.push_back ( Match ( i , neighbours.index1[ i ] ) );
+				}
+			}
+		}
+
+		return matches;
+	}
+
 }    // namespace
 
 
 namespace NiS {
 
-	Matcher::Matcher ( const Feature & feature1 , const Feature & feature2 , bool cross_check ) {
+	Matcher::Matcher ( const Feature & feature1 , const Feature & feature2 , bool cross_check , Backend backend ) {
 
-		matches_ = CreateMatches ( feature1 , feature2 , cross_check );
+		matches_ = CreateMatches ( feature1 , feature2 , cross_check , backend );
 	}
 
 
 	Matcher::Matcher ( const Feature & feature1 , const Feature & feature2 , const PointImage & point_image1 ,
-	                   const PointImage & point_image2 , bool cross_check ) {
+	                   const PointImage & point_image2 , bool cross_check , Backend backend ) {
 
-		matches_ = CreateValidMatches ( feature1 , feature2 , point_image1 , point_image2 , cross_check );
+		matches_ = CreateValidMatches ( feature1 , feature2 , point_image1 , point_image2 , cross_check , backend );
 	}
 
 
@@ -87,7 +128,8 @@ namespace NiS {
 	Matcher::~Matcher ( ) { }
 
 
-	Matcher::Matches Matcher::CreateMatches ( const Feature & feature1 , const Feature & feature2 , bool cross_check ) const {
+	Matcher::Matches Matcher::CreateMatches ( const Feature & feature1 , const Feature & feature2 , bool cross_check ,
+	                                          Backend backend ) const {
 
 		Matches matches;
 
@@ -97,12 +139,25 @@ namespace NiS {
 
 				case Feature::kTypeSIFT:
 				case Feature::kTypeSURF:
-					matches = ::CreateMatches < cv::FlannBasedMatcher > ( feature1 , feature2 , cross_check );
+					// Both directions from the same blocked products
+					if ( backend == kBackendExact and
+					     feature1.GetDescriptors ( ).type ( ) == CV_32FC1 and feature2.GetDescriptors ( ).type ( ) == CV_32FC1 ) {
+						matches = ::CreateMatches ( MatchL2 ( feature1.GetDescriptors ( ) , feature2.GetDescriptors ( ) ) , cross_check );
+					} else {
+						matches = ::CreateMatches < cv::FlannBasedMatcher > ( feature1 , feature2 , cross_check );
+					}
 					break;
 				case Feature::kTypeORB:
 				case Feature::kTypeFREAK:
-					matches = ::CreateMatches < cv::BruteForceMatcher < cv::Hamming > >
-					          ( feature1 , feature2 , cross_check );
+					// Both directions in one pass of the popcount kernels
+					if ( backend == kBackendExact and
+					     feature1.GetDescriptors ( ).depth ( ) == CV_8U and feature2.GetDescriptors ( ).depth ( ) == CV_8U ) {
+						matches = ::CreateMatches ( MatchHamming ( BinaryDescriptors ( feature1.GetDescriptors ( ) ) ,
+						                                           BinaryDescriptors ( feature2.GetDescriptors ( ) ) ) , cross_check );
+					} else {
+						matches = ::CreateMatches < cv::BruteForceMatcher < cv::Hamming > >
+						          ( feature1 , feature2 , cross_check );
+					}
 					break;
 				case Feature::kTypeUnknown:
 					break;
@@ -117,9 +172,9 @@ namespace NiS {
 
 	Matcher::Matches Matcher::CreateValidMatches ( const Feature & feature1 , const Feature & feature2 ,
 	                                               const PointImage & point_image1 , const PointImage & point_image2 ,
-	                                               bool cross_check ) const {
+	                                               bool cross_check , Backend backend ) const {
 
-		const Matches matches = CreateMatches ( feature1 , feature2 , cross_check );
+		const Matches matches = CreateMatches ( feature1 , feature2 , cross_check , backend );
 
 		Matches valid_matches;
 
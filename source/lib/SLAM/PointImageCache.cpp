@@ -0,0 +1,129 @@
+#include "SLAM/PointImageCache.h"
+
+#include <algorithm>
+
+#include <Core/FramePool.h>
+
+namespace NiS {
+
+	PointImage DepthConverter::ConvertImage ( const DepthImage & depth_image ) const {
+
+		PointImage point_image = CreatePooledImage < cv::Vec3f > ( depth_image.rows , depth_image.cols );
+
+		for ( auto row = 0 ; row < depth_image.rows ; ++row ) {
+			for ( auto col = 0 ; col < depth_image.cols ; ++col ) {
+				const WorldPoint p = ConvertPoint ( depth_image , row , col );
+				point_image ( row , col ) = cv::Vec3f ( p.x , p.y , p.z );
+			}
+		}
+
+		return point_image;
+	}
+
+	WorldPoint CoordinateDepthConverter::ConvertPoint ( const DepthImage & depth_image , int row , int col ) const {
+
+		return converter_->ScreenToWorld ( ScreenPoint ( col , row ) , depth_image ( row , col ) );
+	}
+
+	PointImage CoordinateDepthConverter::ConvertImage ( const DepthImage & depth_image ) const {
+
+		return converter_->ConvertDepthImage ( depth_image );
+	}
+
+	WorldPoint CalibratedDepthConverter::ConvertPoint ( const DepthImage & depth_image , int row , int col ) const {
+
+		return calibrator_.ScreenToWorld ( row , col , depth_image ( row , col ) , depth_image.rows , depth_image.cols );
+	}
+
+	PointImage CalibratedDepthConverter::ConvertImage ( const DepthImage & depth_image ) const {
+
+		return calibrator_.CalibrateImage ( depth_image );
+	}
+
+	const std::size_t PointImageCache::kDefaultCapacity;
+
+	PointImageCache::PointImageCache ( std::shared_ptr < const DepthConverter > converter , std::size_t capacity , bool compact ) :
+			converter_ ( std::move ( converter ) ) ,
+			capacity_ ( std::max ( capacity , static_cast < std::size_t > ( 1 ) ) ) ,
+			compact_ ( compact ) { }
+
+	bool PointImageCache::Find ( int id , Entry & entry ) {
+
+		std::lock_guard < std::mutex > lock ( mutex_ );
+
+		auto itr = point_images_.find ( id );
+
+		if ( itr == point_images_.end ( ) ) {
+			return false;
+		}
+
+		recent_.splice ( recent_.begin ( ) , recent_ , itr->second.recent );
+		entry = itr->second;
+
+		return true;
+	}
+
+	void PointImageCache::Insert ( int id , Entry entry ) {
+
+		std::lock_guard < std::mutex > lock ( mutex_ );
+
+		// Converted outside of the lock, two threads may have converted the same image
+		if ( point_images_.count ( id ) ) {
+			return;
+		}
+
+		recent_.push_front ( id );
+		entry.recent = recent_.begin ( );
+		point_images_[ id ] = entry;
+
+		while ( point_images_.size ( ) > capacity_ ) {
+			point_images_.erase ( recent_.back ( ) );
+			recent_.pop_back ( );
+		}
+	}
+
+	PointImage PointImageCache::Get ( int id , const DepthImage & depth_image ) {
+
+		if ( compact_ ) {
+			return GetCompact ( id , depth_image )->Decode ( );
+		}
+
+		Entry entry;
+
+		if ( !Find ( id , entry ) ) {
+			entry.point_image = converter_->ConvertImage ( depth_image );
+			Insert ( id , entry );
+		}
+
+		return entry.point_image;
+	}
+
+	std::shared_ptr < const CompactPointImage > PointImageCache::GetCompact ( int id , const DepthImage & depth_image ) {
+
+		if ( !compact_ ) {
+			return std::make_shared < CompactPointImage > ( Get ( id , depth_image ) );
+		}
+
+		Entry entry;
+
+		if ( !Find ( id , entry ) ) {
+			entry.compact_point_image = std::make_shared < CompactPointImage > ( converter_->ConvertImage ( depth_image ) );
+			Insert ( id , entry );
+		}
+
+		return entry.compact_point_image;
+	}
+
+	void PointImageCache::Erase ( int id ) {
+
+		std::lock_guard < std::mutex > lock ( mutex_ );
+
+		auto itr = point_images_.find ( id );
+
+		if ( itr != point_images_.end ( ) ) {
+			recent_.erase ( itr->second.recent );
+			point_images_.erase ( itr );
+		}
+	}
+
+}
@@ -22,9 +22,6 @@ namespace NiS {
 		const auto & feature1 = key_frame1.GetFeature ( );
 		const auto & feature2 = key_frame2.GetFeature ( );
 
-		const auto & image1 = key_frame1.GetPointImage ( );
-		const auto & image2 = key_frame2.GetPointImage ( );
-
 		assert ( !key_frame1.GetFeature ( ).GetKeyPoints ( ).empty ( ) );
 
 		const NiS::Matcher matcher ( feature1 , feature2 , true );
@@ -38,11 +35,9 @@ namespace NiS {
 
 		for ( const auto & match : matches ) {
 
-			const auto & key_point1 = feature1.GetKeyPoints ( )[ match.first ].pt;
-			const auto & key_point2 = feature2.GetKeyPoints ( )[ match.second ].pt;
-
-			const cv::Point3f pt1 = image1 ( cvRound ( key_point1.y ) , cvRound ( key_point1.x ) );
-			const cv::Point3f pt2 = image2 ( cvRound ( key_point2.y ) , cvRound ( key_point2.x ) );
+			// Points of the key points kept by the keyframes, not the whole point images
+			const cv::Point3f pt1 = key_frame1.GetKeyPointPoint ( match.first );
+			const cv::Point3f pt2 = key_frame2.GetKeyPointPoint ( match.second );
 
 			if ( std::isfinite ( pt1.x ) and std::isfinite ( pt2.x ) and
 			     ( pt1 != cv::Point3f ( 0.0f ) ) and ( pt2 != cv::Point3f ( 0.0f ) ) ) {
@@ -0,0 +1,33 @@
+#include <iostream>
+#include <string>
+
+#include <SLAM/Calibrator.h>
+
+int main ( int argc , char ** argv ) {
+
+	using namespace std;
+
+	if ( argc != 3 ) {
+		cout << "Usage : " << argv[ 0 ] << " <.cal file> <output .fcal file>" << endl;
+		return 1;
+	}
+
+	const auto info = NiS::InternalCalibrationReader::Read ( argv[ 1 ] );
+
+	if ( !info.IsValid ( ) ) {
+		cout << "Invalid calibration file : " << argv[ 1 ] << endl;
+		return 1;
+	}
+
+	if ( !NiS::InternalCalibrationReader::WriteFlat ( argv[ 2 ] , info ) ) {
+		cout << "Cannot write " << argv[ 2 ] << endl;
+		return 1;
+	}
+
+	const auto & table = info.local_calibration_table;
+
+	cout << "Converted " << table.GetRows ( ) << " x " << table.GetCols ( ) << " pixels ("
+	     << table.GetCoefficientCount ( ) << " coefficients) into " << argv[ 2 ] << endl;
+
+	return 0;
+}
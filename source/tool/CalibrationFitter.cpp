@@ -0,0 +1,122 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <Core/MappedRawData.h>
+#include <Core/SequenceFile.h>
+#include <SLAM/CalibrationFitter.h>
+
+namespace {
+
+	// Frames of a .seq file, a .dat file or a directory of .dat files
+	NiS::RawDataFrames ReadFrames ( const std::string & path ) {
+
+		if ( NiS::IsSequenceFile ( path ) ) {
+
+			NiS::SequenceFileReader reader ( path );
+			NiS::RawDataFrames      frames;
+
+			for ( auto i = 0 ; i < reader.GetFrameCount ( ) ; ++i ) {
+				frames.push_back ( reader.GetFrame ( i ) );
+			}
+
+			return frames;
+		}
+
+		if ( boost::filesystem::is_directory ( path ) ) {
+			return NiS::MapRawDataDirectory ( path );
+		}
+
+		return NiS::MapRawDataFrames ( path );
+	}
+}
+
+int main ( int argc , char ** argv ) {
+
+	using namespace std;
+
+	// -d <degree> : degree of the per pixel polynomials
+	int               degree = NiS::CalibrationFitter::kDefaultDegree;
+	vector < string > inputs;
+	bool              valid  = argc >= 3;
+
+	for ( auto i = 2 ; valid and i < argc ; ++i ) {
+
+		if ( string ( argv[ i ] ) != "-d" ) {
+			inputs.push_back ( argv[ i ] );
+			continue;
+		}
+
+		try {
+			valid  = i + 1 < argc;
+			degree = valid ? stoi ( argv[ ++i ] ) : degree;
+		}
+		catch ( const invalid_argument & ) {
+			valid = false;
+		}
+		catch ( const out_of_range & ) {
+			valid = false;
+		}
+	}
+
+	if ( !valid or inputs.empty ( ) ) {
+		cout << "Usage : " << argv[ 0 ] << " <output .cal or .fcal file> <planar target .dat directory, .dat or .seq file>... [-d degree]" << endl;
+		cout << "  The target has to fill the view, recorded at several distances." << endl;
+		return 1;
+	}
+
+	const auto start = chrono::steady_clock::now ( );
+
+	unique_ptr < NiS::CalibrationFitter > fitter;
+	int                                   rejected = 0;
+
+	for ( const auto & input : inputs ) {
+
+		for ( const auto & frame : ReadFrames ( input ) ) {
+
+			const NiS::DepthImage depth_image = frame.depth_image;
+
+			if ( depth_image.empty ( ) ) {
+				continue;
+			}
+
+			if ( !fitter ) {
+				fitter.reset ( new NiS::CalibrationFitter ( depth_image.rows , depth_image.cols , degree ) );
+			}
+
+			if ( !fitter->AddFrame ( depth_image ) ) {
+				++rejected;
+			}
+		}
+
+		cout << "Read " << input << " (" << ( fitter ? fitter->GetFrameCount ( ) : 0 ) << " frames)" << endl;
+	}
+
+	if ( !fitter or fitter->GetFrameCount ( ) == 0 ) {
+		cout << "No frame of a planar target" << endl;
+		return 1;
+	}
+
+	const auto info = fitter->Fit ( );
+
+	const string output = argv[ 1 ];
+	const bool   flat   = boost::filesystem::path ( output ).extension ( ) == NiS::kFlatCalibrationExtension;
+
+	if ( !( flat ? NiS::InternalCalibrationReader::WriteFlat ( output , info )
+	             : NiS::InternalCalibrationReader::WriteCal ( output , info ) ) ) {
+		cout << "Cannot write " << output << endl;
+		return 1;
+	}
+
+	const auto seconds = chrono::duration < double > ( chrono::steady_clock::now ( ) - start ).count ( );
+
+	cout << "Fitted " << fitter->GetFrameCount ( ) << " frames (" << rejected << " without a plane) into " << output
+	     << " in " << seconds << " s" << endl;
+
+	return 0;
+}
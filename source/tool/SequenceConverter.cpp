@@ -0,0 +1,47 @@
+#include <iostream>
+#include <string>
+
+#include <Core/SequenceFile.h>
+
+int main ( int argc , char ** argv ) {
+
+	using namespace std;
+
+	// -z : store the depth images with the lossless DepthCodec
+	const bool encode_depth = ( argc == 5 and string ( argv[ 4 ] ) == "-z" );
+
+	if ( argc != 4 and not encode_depth ) {
+		cout << "Usage : " << argv[ 0 ] << " import <.dat directory> <output .seq file> [-z]" << endl;
+		cout << "        " << argv[ 0 ] << " export <.seq file> <output directory> [-z]" << endl;
+		cout << "        " << argv[ 0 ] << " encode <.dat directory> <output directory>" << endl;
+		cout << "  -z : compress the depth images" << endl;
+		return 1;
+	}
+
+	const string command = argv[ 1 ];
+
+	if ( command == "import" ) {
+
+		const int count = NiS::ImportRawDataDirectory ( argv[ 2 ] , argv[ 3 ] , encode_depth );
+		cout << "Imported " << count << " frames into " << argv[ 3 ] << endl;
+		return count > 0 ? 0 : 1;
+	}
+
+	if ( command == "export" ) {
+
+		const int count = NiS::ExportRawDataDirectory ( argv[ 2 ] , argv[ 3 ] , encode_depth );
+		cout << "Exported " << count << " frames into " << argv[ 3 ] << endl;
+		return count > 0 ? 0 : 1;
+	}
+
+	if ( command == "encode" ) {
+
+		const int count = NiS::EncodeRawDataDirectory ( argv[ 2 ] , argv[ 3 ] );
+		cout << "Encoded " << count << " frames into " << argv[ 3 ] << endl;
+		return count > 0 ? 0 : 1;
+	}
+
+	cout << "Unknown command : " << command << endl;
+
+	return 1;
+}